@@ -9,12 +9,16 @@
 #include "lsh_benchmark.h"
 #include "weight_minhash_benchmark.h"
 #include "dna_benchmark.h"
+#include "prob_minhash_benchmark.h"
+#include "super_minhash_benchmark.h"
 
 namespace LSH_CPP::Benchmark {
     void run_benchmark() {
         dna_benchmark();
         //lsh_benchmark();
         //weight_minhash_benchmark();
+        //prob_minhash_benchmark();
+        //super_minhash_benchmark();
     }
 }
 #endif //LSH_CPP_BENCHMARK_H
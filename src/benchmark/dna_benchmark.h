@@ -11,6 +11,9 @@
 #include "../include/io.h"
 #include "../include/minhash.h"
 #include "../include/lsh.h"
+#include "../include/multi_k_minhash.h"
+#include "../include/sketch_io.h"
+#include "../include/time_def.h"
 
 namespace LSH_CPP::Benchmark {
     namespace CONFIG {
@@ -61,6 +64,14 @@ namespace LSH_CPP::Benchmark {
                 + "k=" + std::to_string(k)
                 + ",threshold=" + std::to_string(threshold)
                 + ",method=set_jaccard_similarity";
+        // 所有 read 的 MinHash 缓存, 第一次运行时计算并保存, 之后直接 mmap.
+        // .key 文件保存计算缓存时输入文件的路径, 大小和修改时间, 和当前输入不一致 (或者缓存文件不完整) 时重新计算.
+        const std::string sketch_cache_filename =
+                output_parent_path
+                + "k=" + std::to_string(k)
+                + ",samples=" + std::to_string(n_sample)
+                + ",method=minhash.sketch";
+        const std::string sketch_cache_key_filename = sketch_cache_filename + ".key";
         const std::string binary_file_suffix = ".binary";
         const std::string text_file_suffix = ".txt";
     }
@@ -441,6 +452,57 @@ namespace LSH_CPP::Benchmark {
         graph.close();
     }
 
+    template<size_t k>
+    using DNAMinHashType = MinHash<StdDNAShinglingHash64<k>, 32, CONFIG::n_sample>;
+
+    /**
+     * k = 5..9 的参数扫描: 每条 read 只遍历一次, 同时得到 5 个 k 的 MinHash, 不需要为每个 k 重新读文件和切分 k-mer.
+     * 输出每个 k 下前 n_query 条 read 与其他 read 相似度 >= threshold 的对数, 用于选择 k 和 threshold.
+     */
+    void multi_k_minhash_sweep(size_t n_query = 100) {
+        using namespace DNA_DATA;
+        using MultiKType = MultiKMinHash<DNAMinHashType, 5, 6, 7, 8, 9>;
+        std::vector<MultiKType> sketches(data.size());
+        TimeVar start = timeNow();
+#pragma omp parallel for schedule(dynamic, 64)
+        for (size_t i = 0; i < data.size(); i++) sketches[i].update(data[i]);
+        std::cout << "multi-k sketch time : " << millisecond_duration(timeNow() - start) << " ms\n";
+        for_constexpr<for_bounds<5, 10>>([&](auto k_value) {
+            constexpr size_t sweep_k = k_value;
+            size_t n_similar = 0;
+            for (size_t i = 0; i < std::min(n_query, data.size()); i++) {
+                for (size_t j = i + 1; j < data.size(); j++) {
+                    n_similar += minhash_jaccard_similarity(sketches[i].template get<sweep_k>(),
+                                                            sketches[j].template get<sweep_k>()) >= threshold;
+                }
+            }
+            std::cout << "k = " << sweep_k << "  similar pairs : " << n_similar << "\n";
+        });
+    }
+
+    /**
+     * 所有 read 的 band 哈希表分别用 std::vector 和 CompressedPostingList 作为 bucket 时的内存.
+     * 输出 key 数 K, label 数 N 和 N/K: 压缩比受 N/K 限制 (见 CompressedPostingList 的注释).
+     */
+    void posting_list_memory() {
+        using namespace DNA_DATA;
+        using CompressedLSH_Type = LSH<XXUInt64Hash64, size_t, 0, 0, n_sample, CompressedPostingList<size_t>>;
+        LSH_Type vector_lsh(threshold, weights);
+        CompressedLSH_Type compressed_lsh(threshold, weights);
+        for (const auto &label : labels) {
+            vector_lsh.insert(minhash_set[label], label);
+            compressed_lsh.insert(minhash_set[label], label);
+        }
+        vector_lsh.shrink_to_fit();
+        compressed_lsh.shrink_to_fit();
+        const size_t n_keys = vector_lsh.key_size(), n_labels = vector_lsh.label_size();
+        std::cout << "keys : " << n_keys << "  labels : " << n_labels
+                  << "  labels per key : " << (double) n_labels / (double) n_keys << "\n";
+        std::cout << "vector bucket memory : " << vector_lsh.memory_usage() << " bytes, compressed bucket memory : "
+                  << compressed_lsh.memory_usage() << " bytes, ratio : "
+                  << (double) vector_lsh.memory_usage() / (double) compressed_lsh.memory_usage() << "\n";
+    }
+
     // [minhash linear scan] 与 [lsh(weight=0.1,0.9) + 过滤] 的比较中, lsh的结果比起minhash只少了一点
     // (因为lsh后面加上了过滤处理,所以lsh结果只会比minhash少,不会比minhash多),时间上lsh减少了一半,加速效率较好.
     // (这里的时间包括了处理和写入文件的所有时间)
@@ -452,11 +514,12 @@ namespace LSH_CPP::Benchmark {
         Test<1000>();
 #elif defined(WEIGHT_MINHASH_TEST)
         // 取第100条与后面100条比较结果
+        // 直接用 k-mer 的 2-bit 编码计数作为稀疏权重向量, 不需要为每条 read 分配 4^k 维的权重向量.
         constexpr auto dim = pow(4, k);
-        using weight_vector_t = std::vector<uint32_t>;
+        using sparse_weight_vector_t = std::vector<std::pair<uint64_t, uint32_t>>;
         using weight_minhash_t =  WeightMinHash<dim, uint32_t, n_sample>;
         // for (const auto &doc:data) {
-        HashSet<DNA_Shingling<k, has_weight>> set_A;
+        sparse_weight_vector_t vector_A;
         weight_minhash_t hash_A;
         double abs_mean_error = 0;
         constexpr size_t count = 1500;
@@ -465,19 +528,15 @@ namespace LSH_CPP::Benchmark {
         std::uniform_int_distribution<size_t> dis(0, data.size() - count - 1);
         auto start = dis(random_gen);
         for (size_t i = start; i <= start + count; i++) {
-            auto set = split_dna_shingling<k, LSH_CPP::has_weight>(data[i]);
-            weight_vector_t vector(dim);
-            for (const auto &item:set) {
-                vector[item.value().to_ulong()] = item.weight();
-            }
+            auto vector = dna_kmer_code_count<k>(data[i]);
             if (i == start) {
                 hash_A.update(vector);
-                set_A = set;
+                vector_A = vector;
             } else {
                 weight_minhash_t temp;
                 temp.update(vector);
                 auto sim = weight_minhash_jaccard(hash_A, temp);
-                auto actual_sim = generalized_jaccard_similarity(set_A, set);
+                auto actual_sim = generalized_jaccard_similarity(vector_A, vector);
                 auto abs_error = std::fabs(sim - actual_sim);
                 std::cout << sim << " " << actual_sim << " " << abs_error << "\n";
                 abs_mean_error += abs_error;
@@ -487,15 +546,39 @@ namespace LSH_CPP::Benchmark {
 #else
         for (size_t i = 0; i < data.size(); i++) labels.push_back(i);
         minhash_set.reserve(data.size());
-        int progress = 0;
-        for (const auto &doc : data) {
-            std::cout << "process " << ++progress << " doc...\n";
-            auto dna_shingling_set = split_dna_shingling<k, WeightFlag::no_weight>(doc);
-            MinHashType temp;
-            temp.update(dna_shingling_set);
-            minhash_set.push_back(temp);
+        // 缓存 key: 输入文件的路径, 大小和修改时间 (纳秒), 输入文件被替换或者修改以后 key 会改变
+        auto input_key = [](const std::string &path) {
+            auto mtime = std::filesystem::last_write_time(path).time_since_epoch().count();
+            return path + " " + std::to_string(std::filesystem::file_size(path)) + " " + std::to_string(mtime);
+        };
+        const std::string cache_key = input_key(sra_dna_data_path);
+        std::string saved_key;
+        if (std::ifstream key_in(sketch_cache_key_filename); key_in) std::getline(key_in, saved_key);
+        SketchFile<MinHashType> sketch_file;
+        if (saved_key == cache_key && sketch_file.try_load(sketch_cache_filename) &&
+            sketch_file.size() == data.size()) {
+            for (size_t i = 0; i < sketch_file.size(); i++) minhash_set.push_back(sketch_file.to_minhash(i));
+            std::cout << "load " << sketch_file.size() << " sketches from " << sketch_cache_filename << "\n";
+        } else {
+            int progress = 0;
+            for (const auto &doc : data) {
+                std::cout << "process " << ++progress << " doc...\n";
+                auto dna_shingling_set = split_dna_shingling<k, WeightFlag::no_weight>(doc);
+                MinHashType temp;
+                temp.update(dna_shingling_set);
+                minhash_set.push_back(temp);
+            }
+            std::vector<std::string> names;
+            names.reserve(labels.size());
+            for (const auto &label : labels) names.push_back(std::to_string(label));
+            std::filesystem::create_directories(output_parent_path);
+            // 先写 sketch 再写 key: 中途退出时旧的 key 和当前输入不一致, 下一次仍然会重新计算
+            SketchFile<MinHashType>::save(sketch_cache_filename, minhash_set, names);
+            std::ofstream(sketch_cache_key_filename, std::ios::trunc) << cache_key << "\n";
         }
         minhash_output_graph_file("graph/");
+        // multi_k_minhash_sweep();
+        // posting_list_memory();
         // minhash_dna_compress("sra/");
         // ground_truth_dna_compress("sra/");
         // minhash_linear_scan_query(minhash_output_filename_prefix + binary_file_suffix);
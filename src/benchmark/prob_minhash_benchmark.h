@@ -0,0 +1,94 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_PROB_MINHASH_BENCHMARK_H
+#define LSH_CPP_PROB_MINHASH_BENCHMARK_H
+
+#include "../include/lsh_cpp.h"
+#include "../include/util.h"
+#include "../include/k_shingles.h"
+#include "../include/io.h"
+#include "../include/weight_minhash.h"
+#include "../include/prob_minhash.h"
+#include "../include/time_def.h"
+#include "dna_benchmark.h"
+
+namespace LSH_CPP::Benchmark {
+    namespace prob_minhash_detail {
+        constexpr size_t k = 6;
+        // 每个文档由连续的若干条 read 组成: 单条 read 的非0 k-mer 很少, 50 条 read 的计数向量更稠密, 权重也更大
+        constexpr std::array<size_t, 2> reads_per_document = {1, 50};
+        constexpr size_t n_pairs = 200;
+        constexpr auto n_samples = make_constexpr_array(make_sequence<4>([](size_t index) {
+            return size_t(64) << index;
+        }));// 64,128,256,512.
+
+        using sparse_weight_vector_t = std::vector<std::pair<uint64_t, uint32_t>>;
+
+        // 从 fastq 数据 (和 dna_benchmark 相同的 SRA 数据) 中取 n_pairs 对相邻文档的 k-mer 计数向量
+        std::vector<std::pair<sparse_weight_vector_t, sparse_weight_vector_t>>
+        make_kmer_count_pairs(const std::vector<std::string> &reads, size_t n_reads) {
+            std::vector<std::pair<sparse_weight_vector_t, sparse_weight_vector_t>> pairs;
+            pairs.reserve(n_pairs);
+            auto document = [&](size_t index) {
+                std::string doc;
+                for (size_t i = index * n_reads; i < (index + 1) * n_reads; i++) doc += reads[i];
+                return dna_kmer_code_count<k>(doc);
+            };
+            for (size_t i = 0; i < n_pairs && (2 * i + 2) * n_reads <= reads.size(); i++) {
+                pairs.emplace_back(document(2 * i), document(2 * i + 1));
+            }
+            return pairs;
+        }
+    }
+
+    /**
+     * ICWS (WeightMinHash) 与 ProbMinHash 在 k-mer 计数向量上的吞吐量和估计误差对比.
+     * 数据是 SRA fastq 中真实 read 的 k-mer 计数向量 (读取方式和 dna_benchmark 相同).
+     * ICWS 估计 generalized jaccard, ProbMinHash 估计 probability jaccard, 误差分别相对各自的真实值计算.
+     */
+    void prob_minhash_benchmark() {
+        using namespace prob_minhash_detail;
+        const auto reads = get_document_from_fastq_file(CONFIG::sra_dna_data_path);
+        for (size_t n_reads : reads_per_document) {
+            auto pairs = make_kmer_count_pairs(reads, n_reads);
+            if (pairs.empty()) {
+                fprintf(stderr, "not enough reads in %s\n", CONFIG::sra_dna_data_path);
+                return;
+            }
+            printf("reads per document : %zu  pairs : %zu\n", n_reads, pairs.size());
+            std::vector<double> generalized_jaccard, probability_jaccard;
+            for (const auto &[a, b] : pairs) {
+                generalized_jaccard.push_back(generalized_jaccard_similarity(a, b));
+                probability_jaccard.push_back(probability_jaccard_similarity(a, b));
+            }
+            printf("%-10s %-14s %-14s %-14s %-14s\n", "n_sample", "icws(ms)", "icws error", "prob(ms)", "prob error");
+            for_constexpr<for_bounds<0, n_samples.size()>>([&](auto index) {
+                constexpr auto sample = n_samples[index];
+                using icws_t = WeightMinHash<pow(4, k), uint32_t, sample>;
+                using prob_t = ProbMinHash<sample>;
+                icws_t{}.update(pairs[0].first); // 预先生成采样矩阵, 不计入时间
+                double icws_time = 0, icws_error = 0, prob_time = 0, prob_error = 0;
+                for (size_t i = 0; i < pairs.size(); i++) {
+                    icws_t icws_a, icws_b;
+                    prob_t prob_a, prob_b;
+                    TimeVar start = timeNow();
+                    icws_a.update(pairs[i].first);
+                    icws_b.update(pairs[i].second);
+                    icws_time += millisecond_duration(timeNow() - start);
+                    start = timeNow();
+                    prob_a.update(pairs[i].first);
+                    prob_b.update(pairs[i].second);
+                    prob_time += millisecond_duration(timeNow() - start);
+                    icws_error += std::fabs(weight_minhash_jaccard(icws_a, icws_b) - generalized_jaccard[i]);
+                    prob_error += std::fabs(weight_minhash_jaccard(prob_a, prob_b) - probability_jaccard[i]);
+                }
+                double n_sketches = 2.0 * (double) pairs.size();
+                printf("%-10zu %-14.5f %-14.5f %-14.5f %-14.5f\n", sample, icws_time / n_sketches,
+                       icws_error / (double) pairs.size(), prob_time / n_sketches, prob_error / (double) pairs.size());
+            });
+        }
+    }
+}
+#endif //LSH_CPP_PROB_MINHASH_BENCHMARK_H
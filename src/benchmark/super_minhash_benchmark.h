@@ -0,0 +1,79 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_SUPER_MINHASH_BENCHMARK_H
+#define LSH_CPP_SUPER_MINHASH_BENCHMARK_H
+
+#include "../include/lsh_cpp.h"
+#include "../include/util.h"
+#include "../include/hash.h"
+#include "../include/minhash.h"
+#include "../include/super_minhash.h"
+#include "../include/time_def.h"
+
+namespace LSH_CPP::Benchmark {
+    namespace super_minhash_detail {
+        constexpr std::array<size_t, 2> set_sizes = {100, 1000}; // 短 read 的 k-mer 集合通常只有 100 多个元素
+        constexpr size_t n_pairs = 200;
+        constexpr std::array<double, 3> jaccard_levels = {0.5, 0.7, 0.9};
+        constexpr auto n_samples = make_constexpr_array(make_sequence<4>([](size_t index) {
+            return size_t(64) << index;
+        }));// 64,128,256,512.
+
+        // 生成 n_pairs 对大小为 set_size, jaccard 相似度为 jaccard 的集合: |A∩B| = 2 * n * J / (1 + J)
+        std::vector<std::pair<HashSet<uint64_t>, HashSet<uint64_t>>> make_set_pairs(size_t set_size, double jaccard) {
+            std::mt19937_64 generator(2026);
+            auto intersection = static_cast<size_t>(std::round(2.0 * set_size * jaccard / (1 + jaccard)));
+            std::vector<std::pair<HashSet<uint64_t>, HashSet<uint64_t>>> pairs(n_pairs);
+            for (auto &[a, b] : pairs) {
+                for (size_t i = 0; i < intersection; i++) {
+                    uint64_t value = generator();
+                    a.insert(value);
+                    b.insert(value);
+                }
+                while (a.size() < set_size) a.insert(generator());
+                while (b.size() < set_size) b.insert(generator());
+            }
+            return pairs;
+        }
+    }
+
+    /**
+     * 相同 signature 长度下 MinHash 与 SuperMinHash 的计算时间和 jaccard 估计误差 (均方根误差) 对比.
+     */
+    void super_minhash_benchmark() {
+        using namespace super_minhash_detail;
+        printf("%-10s %-10s %-8s %-14s %-14s %-14s %-14s\n", "set_size", "n_sample", "jaccard", "minhash(ms)",
+               "minhash rmse", "super(ms)", "super rmse");
+        for (size_t set_size : set_sizes) for (double jaccard : jaccard_levels) {
+            auto pairs = make_set_pairs(set_size, jaccard);
+            for_constexpr<for_bounds<0, n_samples.size()>>([&](auto index) {
+                constexpr auto sample = n_samples[index];
+                using minhash_t = MinHash<XXUInt64Hash64, 64, sample>;
+                using super_minhash_t = SuperMinHash<XXUInt64Hash64, sample>;
+                double minhash_time = 0, minhash_error = 0, super_time = 0, super_error = 0;
+                for (const auto &[a, b] : pairs) {
+                    double actual = jaccard_similarity(a, b);
+                    minhash_t minhash_a, minhash_b;
+                    super_minhash_t super_a, super_b;
+                    TimeVar start = timeNow();
+                    minhash_a.update(a);
+                    minhash_b.update(b);
+                    minhash_time += millisecond_duration(timeNow() - start);
+                    start = timeNow();
+                    super_a.update(a);
+                    super_b.update(b);
+                    super_time += millisecond_duration(timeNow() - start);
+                    minhash_error += std::pow(minhash_jaccard_similarity(minhash_a, minhash_b) - actual, 2);
+                    super_error += std::pow(minhash_jaccard_similarity(super_a, super_b) - actual, 2);
+                }
+                double n_sketches = 2.0 * (double) pairs.size();
+                printf("%-10ld %-10ld %-8.2f %-14.5f %-14.5f %-14.5f %-14.5f\n", set_size, sample, jaccard,
+                       minhash_time / n_sketches, std::sqrt(minhash_error / (double) pairs.size()),
+                       super_time / n_sketches, std::sqrt(super_error / (double) pairs.size()));
+            });
+        }
+    }
+}
+#endif //LSH_CPP_SUPER_MINHASH_BENCHMARK_H
@@ -0,0 +1,92 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_LOAD_GENERATOR_H
+#define LSH_CPP_LOAD_GENERATOR_H
+
+#include "../include/lsh_cpp.h"
+#include "../include/util.h"
+#include "../include/time_def.h"
+#include "../server/protocol.h"
+
+namespace LSH_CPP::Client {
+    struct LoadReport {
+        size_t n_requests = 0;
+        size_t n_errors = 0;
+        size_t n_results = 0;
+        double seconds = 0;
+        std::vector<double> latencies; // ms
+
+        void print() const {
+            using namespace Statistic;
+            std::cout << "===============  Load report  ===============\n";
+            std::cout << "requests : " << n_requests << "  errors : " << n_errors
+                      << "  mean results per query : " << (n_requests > 0 ? (double) n_results / n_requests : 0.0)
+                      << "\n";
+            std::cout << "time : " << seconds << " seconds  QPS : " << (double) n_requests / seconds << "\n";
+            if (latencies.empty()) return;
+            std::cout << "latency(ms) mean : " << get_mean(latencies)
+                      << "  p50 : " << get_percentile(latencies, 0.5, 0.001)
+                      << "  p90 : " << get_percentile(latencies, 0.9, 0.001)
+                      << "  p99 : " << get_percentile(latencies, 0.99, 0.001)
+                      << "  p99.9 : " << get_percentile(latencies, 0.999, 0.0001) << "\n";
+        }
+    };
+
+    /**
+     * 闭环压测: n_connections 个连接并发, 每个连接串行发送 n_requests_per_connection 个 QuerySequence 请求,
+     * 收到响应后才发送下一个. 查询序列从 data 中随机抽取. 并发连接数决定了服务端 batch 的大小.
+     */
+    LoadReport run_load(const std::string &socket_path, const std::vector<std::string> &data,
+                        size_t n_connections, size_t n_requests_per_connection) {
+        using namespace LSH_CPP::Server;
+        std::vector<LoadReport> reports(n_connections);
+        std::vector<std::thread> threads;
+        TimeVar start = timeNow();
+        for (size_t c = 0; c < n_connections; c++) {
+            threads.emplace_back([&, c]() {
+                auto &report = reports[c];
+                int fd = connect_unix_socket(socket_path);
+                if (fd < 0) {
+                    fprintf(stderr, "connect %s fail: %s\n", socket_path.c_str(), std::strerror(errno));
+                    report.n_errors = n_requests_per_connection;
+                    return;
+                }
+                std::mt19937_64 generator(c);
+                std::uniform_int_distribution<size_t> dis(0, data.size() - 1);
+                std::vector<char> frame;
+                std::vector<QueryResult> results;
+                report.latencies.reserve(n_requests_per_connection);
+                for (uint64_t id = 0; id < n_requests_per_connection; id++) {
+                    const auto &sequence = data[dis(generator)];
+                    auto request = make_request(id, RequestType::QuerySequence, sequence.data(), sequence.size());
+                    TimeVar request_start = timeNow();
+                    uint64_t response_id;
+                    ResponseStatus status;
+                    if (!write_full(fd, request.data(), request.size()) || !read_frame(fd, frame) ||
+                        !parse_response(frame, response_id, status, results)) {
+                        report.n_errors += n_requests_per_connection - id;
+                        break;
+                    }
+                    report.latencies.push_back(millisecond_duration(timeNow() - request_start));
+                    report.n_requests++;
+                    if (status != ResponseStatus::Ok || response_id != id) report.n_errors++;
+                    report.n_results += results.size();
+                }
+                ::close(fd);
+            });
+        }
+        for (auto &thread : threads) thread.join();
+        LoadReport total;
+        total.seconds = second_duration(timeNow() - start);
+        for (const auto &report : reports) {
+            total.n_requests += report.n_requests;
+            total.n_errors += report.n_errors;
+            total.n_results += report.n_results;
+            total.latencies.insert(total.latencies.end(), report.latencies.begin(), report.latencies.end());
+        }
+        return total;
+    }
+}
+#endif //LSH_CPP_LOAD_GENERATOR_H
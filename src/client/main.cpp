@@ -0,0 +1,23 @@
+//
+// Created by junior on 2026/10/18.
+//
+#include "../include/io.h"
+#include "load_generator.h"
+
+// usage: ./lsh_cpp_client [socket_path] [fastq_path] [connections] [requests_per_connection]
+int main(int argc, char *argv[]) {
+    using namespace LSH_CPP;
+    const std::string socket_path = argc > 1 ? argv[1] : "/tmp/lsh_cpp.sock";
+    const std::string data_path = argc > 2 ? argv[2] : "../../dna-data/sra_data.fastq";
+    const size_t n_connections = argc > 3 ? std::stoul(argv[3]) : 16;
+    const size_t n_requests = argc > 4 ? std::stoul(argv[4]) : 1000;
+
+    auto data = get_document_from_fastq_file(data_path.c_str());
+    if (data.empty()) {
+        fprintf(stderr, "no read in %s\n", data_path.c_str());
+        return -1;
+    }
+    std::cout << "run " << n_connections << " connections x " << n_requests << " requests ...\n";
+    Client::run_load(socket_path, data, n_connections, n_requests).print();
+    return 0;
+}
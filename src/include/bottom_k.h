@@ -0,0 +1,181 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_BOTTOM_K_H
+#define LSH_CPP_BOTTOM_K_H
+
+#include "lsh_cpp.h"
+#include "hash.h"
+
+namespace LSH_CPP {
+    /**
+     * Bottom-k sketch (KMV): 只用一个哈希函数, 保存集合中最小的 k 个不同哈希值.
+     * 参考: Cohen & Kaplan, "Summarizing data using bottom-k sketches", PODC 2007;
+     *       Beyer et al., "On synopses for distinct-value estimation under multiset operations", SIGMOD 2007.
+     *
+     * 与 MinHash 的 k 个独立最小值相比:
+     *   1. 每个元素只计算一次哈希, 大部分元素直接和当前第 k 小的值比较后丢弃, 复杂度 O(|set| log k);
+     *   2. |set| <= k 时保存了集合所有元素的哈希值, jaccard / containment / 基数都是精确的 (忽略 64 位哈希碰撞),
+     *      适合长度差别很大的 read (短 read 不会因为 k 个独立最小值而浪费计算和精度);
+     *   3. 可以合并: 两个 sketch 合并后的 bottom-k 就是并集的 bottom-k, 所以可以按文件 / 线程分别计算再 merge.
+     * 哈希值保存在容量为 k 的有序数组中, 插入位置用 AVX2 比较计数 (没有 AVX2 时二分查找), 然后整体后移.
+     *
+     * @tparam HashFunc 和 MinHash 相同的哈希函数 (XXStringViewHash64, StdDNAShinglingHash64 ...), 必须返回 64 位哈希值.
+     */
+    template<typename HashFunc = XXStringViewHash64, size_t k = 128>
+    class BottomKSketch {
+        static_assert(k > 1, "bottom-k sketch needs k > 1.");
+    private:
+        HashFunc hash_func;
+        size_t n_values = 0;
+        bool evicted = false; // 是否丢弃过哈希值, 也就是集合的不同元素超过了 k 个
+        alignas(32) std::array<uint64_t, k> values; // [0, n_values) 升序, 没有重复
+
+        // 小于 hash_value 的元素个数, 也就是插入位置
+        [[nodiscard]] size_t rank(uint64_t hash_value) const {
+#ifdef __AVX2__
+            if constexpr (k <= 256) {
+                // AVX2 只有有符号 64 位比较, 两边同时翻转符号位后比较结果和无符号比较相同
+                const __m256i sign = _mm256_set1_epi64x(static_cast<long long>(0x8000000000000000ull));
+                const __m256i target = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(hash_value)), sign);
+                size_t count = 0, i = 0;
+                for (; i + 4 <= n_values; i += 4) {
+                    __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(&values[i])),
+                                                 sign);
+                    auto mask = static_cast<uint32_t>(_mm256_movemask_pd(
+                            _mm256_castsi256_pd(_mm256_cmpgt_epi64(target, v))));
+                    count += static_cast<size_t>(__builtin_popcount(mask));
+                }
+                for (; i < n_values; i++) count += (values[i] < hash_value);
+                return count;
+            }
+#endif
+            return static_cast<size_t>(std::lower_bound(values.begin(), values.begin() + n_values, hash_value) -
+                                       values.begin());
+        }
+
+    public:
+        explicit BottomKSketch(HashFunc &&hash_func = HashFunc{}) : hash_func(hash_func) {}
+
+        // 直接用 64 位哈希值更新
+        void update_hash(uint64_t hash_value) {
+            if (n_values == k && hash_value >= values[k - 1]) { // 大部分元素在这里直接丢弃
+                evicted |= hash_value != values[k - 1];
+                return;
+            }
+            size_t position = rank(hash_value);
+            if (position < n_values && values[position] == hash_value) return; // 重复元素
+            size_t n_move = std::min(n_values, k - 1) - position;
+            std::memmove(&values[position + 1], &values[position], n_move * sizeof(uint64_t));
+            values[position] = hash_value;
+            if (n_values < k) n_values++; else evicted = true; // 原来第 k 小的值被挤出
+        }
+
+        template<typename T>
+        void update(const T &val) {
+            static_assert(std::is_same_v<decltype(hash_func(val)), uint64_t>, "BottomKSketch needs a 64-bit hash.");
+            update_hash(hash_func(val));
+        }
+
+        template<typename T>
+        void update(const HashSet<T> &data_set) {
+            for (const auto &data : data_set) update(data);
+        }
+
+        // 合并另一个 sketch, 结果等于并集的 bottom-k sketch
+        void merge(const BottomKSketch &other) {
+            std::array<uint64_t, k> merged;
+            size_t i = 0, j = 0, n = 0;
+            while (n < k && (i < n_values || j < other.n_values)) {
+                if (j == other.n_values || (i < n_values && values[i] < other.values[j])) {
+                    merged[n++] = values[i++];
+                } else if (i == n_values || other.values[j] < values[i]) {
+                    merged[n++] = other.values[j++];
+                } else {
+                    merged[n++] = values[i++];
+                    j++;
+                }
+            }
+            // 没有合并进来的哈希值都比第 k 小的值大, 是被丢弃的不同元素
+            evicted = evicted || other.evicted || i < n_values || j < other.n_values;
+            std::copy(merged.begin(), merged.begin() + n, values.begin());
+            n_values = n;
+        }
+
+        // 集合没有超过 k 个不同元素 (包括恰好 k 个) 时, sketch 保存了所有元素, 各种估计都是精确的
+        [[nodiscard]] bool is_exact() const { return !evicted; }
+
+        [[nodiscard]] size_t size() const { return n_values; }
+
+        [[nodiscard]] const uint64_t *data() const { return values.data(); }
+
+        // 第 k 小的哈希值, 只在 sketch 已满时有意义
+        [[nodiscard]] uint64_t threshold() const { return values[k - 1]; }
+
+        // 基数估计: 精确时就是元素个数, 否则为 (k - 1) / (第 k 小的哈希值 / 2^64) (无偏估计)
+        [[nodiscard]] double cardinality() const {
+            if (is_exact()) return (double) n_values;
+            return (double) (k - 1) / std::ldexp((double) values[k - 1], -64);
+        }
+    };
+
+    namespace detail {
+        /**
+         * 两个 bottom-k sketch 的并集统计: 并集的 bottom-k (两个都精确时是完整的并集) 中有多少个哈希值同时出现在两个 sketch 中.
+         * 只有不超过两个 sketch 各自第 k 小的值的部分才能确定是否属于两个集合, 所以并集 sketch 的大小最多为 k.
+         * 返回 { 并集 sketch 中同时属于 A 和 B 的个数, 并集 sketch 的大小, 并集 sketch 的最大值 }
+         */
+        template<typename H, size_t k>
+        std::tuple<size_t, size_t, uint64_t>
+        bottom_k_union_statistic(const BottomKSketch<H, k> &A, const BottomKSketch<H, k> &B) {
+            const bool exact = A.is_exact() && B.is_exact();
+            const size_t limit = exact ? A.size() + B.size() : k;
+            size_t i = 0, j = 0, n = 0, both = 0;
+            uint64_t last = 0;
+            while (n < limit && (i < A.size() || j < B.size())) {
+                if (j == B.size() || (i < A.size() && A.data()[i] < B.data()[j])) {
+                    last = A.data()[i++];
+                } else if (i == A.size() || B.data()[j] < A.data()[i]) {
+                    last = B.data()[j++];
+                } else {
+                    last = A.data()[i++];
+                    j++;
+                    both++;
+                }
+                n++;
+            }
+            return {both, n, last};
+        }
+    }
+
+    // 由 bottom-k sketch 估计 jaccard 相似度, 两个集合都不超过 k 个元素时是精确值
+    template<typename H, size_t k>
+    double minhash_jaccard_similarity(const BottomKSketch<H, k> &A, const BottomKSketch<H, k> &B) {
+        auto[both, n, last] = detail::bottom_k_union_statistic(A, B);
+        return n == 0 ? 0 : (double) both / (double) n;
+    }
+
+    // 估计并集大小
+    template<typename H, size_t k>
+    double minhash_union_size(const BottomKSketch<H, k> &A, const BottomKSketch<H, k> &B) {
+        auto[both, n, last] = detail::bottom_k_union_statistic(A, B);
+        if ((A.is_exact() && B.is_exact()) || n < k) return (double) n;
+        return (double) (k - 1) / std::ldexp((double) last, -64);
+    }
+
+    // 估计交集大小: jaccard * |A ∪ B|
+    template<typename H, size_t k>
+    double minhash_intersection_size(const BottomKSketch<H, k> &A, const BottomKSketch<H, k> &B) {
+        return minhash_jaccard_similarity(A, B) * minhash_union_size(A, B);
+    }
+
+    // 估计包含度 containment(A, B) = |A ∩ B| / |A|
+    template<typename H, size_t k>
+    double minhash_containment(const BottomKSketch<H, k> &A, const BottomKSketch<H, k> &B) {
+        double size_a = A.cardinality();
+        if (size_a <= 0) return 0;
+        return std::min(1.0, minhash_intersection_size(A, B) / size_a);
+    }
+}
+#endif //LSH_CPP_BOTTOM_K_H
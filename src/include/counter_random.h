@@ -0,0 +1,80 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_COUNTER_RANDOM_H
+#define LSH_CPP_COUNTER_RANDOM_H
+
+#include "lsh_cpp.h"
+
+namespace LSH_CPP {
+    /**
+     * Philox4x32-10 counter-based 随机数生成器 (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3").
+     * 输出只由 (counter, key) 决定, 没有内部状态: 同一个 (seed, 元素, 采样) 在任何进程、任何线程、任何调用顺序下
+     * 得到的随机数都相同, 所以不需要预先生成并保存采样矩阵.
+     * 作为 WeightMinHash 的 RandomGenerator 模板参数时, 表示使用按需生成采样参数的模式.
+     */
+    struct Philox4x32 {
+        static constexpr uint32_t M0 = 0xD2511F53u, M1 = 0xCD9E8D57u; // round multiplier
+        static constexpr uint32_t W0 = 0x9E3779B9u, W1 = 0xBB67AE85u; // key schedule (Weyl sequence)
+        static constexpr size_t rounds = 10;
+
+        // 原地把 counter {c0,c1,c2,c3} 变换为 4 个 32-bit 随机数. 只有标量整数运算, 可以在 omp simd 循环中向量化.
+        static inline void generate(uint32_t &c0, uint32_t &c1, uint32_t &c2, uint32_t &c3,
+                                    uint32_t k0, uint32_t k1) {
+            for (size_t round = 0; round < rounds; round++) {
+                uint64_t p0 = static_cast<uint64_t>(M0) * c0;
+                uint64_t p1 = static_cast<uint64_t>(M1) * c2;
+                uint32_t n0 = static_cast<uint32_t>(p1 >> 32u) ^ c1 ^ k0;
+                uint32_t n2 = static_cast<uint32_t>(p0 >> 32u) ^ c3 ^ k1;
+                c1 = static_cast<uint32_t>(p1);
+                c3 = static_cast<uint32_t>(p0);
+                c0 = n0;
+                c2 = n2;
+                k0 += W0;
+                k1 += W1;
+            }
+        }
+
+#ifdef __AVX2__
+
+        // 32x32 -> 64 位乘法, 8 个 lane 同时计算, 分别返回乘积的高 32 位和低 32 位
+        static inline void mul_hi_lo(__m256i a, __m256i b, __m256i &hi, __m256i &lo) {
+            __m256i even = _mm256_mul_epu32(a, b);                                             // lane 0,2,4,6
+            __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32)); // lane 1,3,5,7
+            lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+            hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+        }
+
+        // 8 个 counter 同时计算, 结果和逐个调用 generate 相同
+        static inline void generate(__m256i &c0, __m256i &c1, __m256i &c2, __m256i &c3,
+                                    uint32_t k0, uint32_t k1) {
+            const __m256i m0 = _mm256_set1_epi32(static_cast<int>(M0)), m1 = _mm256_set1_epi32(static_cast<int>(M1));
+            for (size_t round = 0; round < rounds; round++) {
+                __m256i hi0, lo0, hi1, lo1;
+                mul_hi_lo(m0, c0, hi0, lo0);
+                mul_hi_lo(m1, c2, hi1, lo1);
+                c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32(static_cast<int>(k0)));
+                c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32(static_cast<int>(k1)));
+                c1 = lo1;
+                c3 = lo0;
+                k0 += W0;
+                k1 += W1;
+            }
+        }
+
+        static inline __m256 uniform23(__m256i bits) {
+            __m256 x = _mm256_cvtepi32_ps(_mm256_and_si256(bits, _mm256_set1_epi32(0x7FFFFF)));
+            return _mm256_mul_ps(_mm256_add_ps(x, _mm256_set1_ps(0.5f)), _mm256_set1_ps(1.0f / 8388608.0f));
+        }
+
+#endif
+
+        // 低 23 位映射到 (0,1) 开区间上的 float: (x + 0.5) / 2^23, 最大值 1 - 2^-24 和最小值 2^-24 都可以精确表示
+        // (float 的有效位是 24 位, 用 24 位时 0xFFFFFF + 0.5 会舍入为 2^24, 得到 1.0), 保证后面的 ln(u) 和 ln(-ln(u)) 有限.
+        static inline float uniform23(uint32_t bits) {
+            return (static_cast<float>(bits & 0x7FFFFFu) + 0.5f) * (1.0f / 8388608.0f);
+        }
+    };
+}
+#endif //LSH_CPP_COUNTER_RANDOM_H
@@ -0,0 +1,236 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_HAMMING_INDEX_H
+#define LSH_CPP_HAMMING_INDEX_H
+
+#include "lsh_cpp.h"
+
+namespace LSH_CPP {
+    /**
+     * 64 位指纹 (比如 SimHash<64>) 的汉明距离近邻索引: 查询所有与 query 汉明距离 <= max_distance 的指纹.
+     * 参考: Manku et al., "Detecting Near-Duplicates for Web Crawling", WWW 2007.
+     *
+     * 把 64 位按顺序切分成 max_distance + 1 个连续的 block, 由抽屉原理, 汉明距离 <= max_distance 的两个指纹
+     * 至少有一个 block 完全相同. 第 t 张表保存所有指纹循环左移 (使 block t 位于最高位) 以后的值, 并按该值排序,
+     * 查询时在每张表中二分查找最高位 block 与 query 相同的区间, 然后对区间内的指纹用 popcount 验证汉明距离.
+     * 同一个结果可能在多张表中命中, 只在第一个完全相同的 block 所在的表中返回, 所以结果不需要去重.
+     *
+     * 索引是只读的: 通过 build 批量构建 (每张表一次排序), 通过 save / load 持久化, load 直接 mmap 文件, 不需要读入内存.
+     * 每张表的 block 宽度约为 64 / (max_distance + 1) 位, 数据量 n 时每次查询在每张表中平均需要验证 n / 2^width 个指纹,
+     * 所以大数据量下应该选择较小的 max_distance (比如 n = 10^9 时 max_distance = 3, 每个 block 16 位).
+     *
+     * @tparam Label 必须是 trivially copyable 的类型 (一般是整数编号), 因为索引文件直接保存 Entry 的二进制.
+     */
+    template<size_t max_distance = 3, typename Label = size_t>
+    class HammingIndex {
+        static_assert(max_distance < 64, "max_distance should be less than 64.");
+        static_assert(std::is_trivially_copyable_v<Label>, "HammingIndex only supports trivially copyable label.");
+    public:
+        using FingerprintType = uint64_t;
+        static constexpr size_t n_tables = max_distance + 1;
+
+        struct Entry {
+            FingerprintType key; // 循环左移以后的指纹
+            Label label;
+        };
+
+    private:
+        // 索引文件头
+        struct FileHeader {
+            char magic[8];
+            uint64_t version;
+            uint64_t distance;
+            uint64_t entry_size;
+            uint64_t size;
+        };
+        static constexpr char file_magic[8] = {'L', 'S', 'H', 'H', 'A', 'M', 'M', '\0'};
+        static constexpr uint64_t file_version = 1;
+
+        [[noreturn]] static void throw_io_error(const char *operation, const std::string &path) {
+            throw std::system_error(errno, std::generic_category(),
+                                    std::string(operation) + " hamming index file " + path);
+        }
+
+        // block t 覆盖的位区间 [low, high)
+        static constexpr size_t block_low(size_t t) { return 64 * t / n_tables; }
+
+        static constexpr size_t block_high(size_t t) { return 64 * (t + 1) / n_tables; }
+
+        static constexpr size_t block_width(size_t t) { return block_high(t) - block_low(t); }
+
+        static constexpr size_t rotation(size_t t) { return (64 - block_high(t)) % 64; }
+
+        static inline FingerprintType rotate_left(FingerprintType x, size_t shift) {
+            return shift == 0 ? x : (x << shift) | (x >> (64 - shift));
+        }
+
+        static inline FingerprintType rotate_right(FingerprintType x, size_t shift) {
+            return shift == 0 ? x : (x >> shift) | (x << (64 - shift));
+        }
+
+        // 差异位 diff 在 block t 上是否为 0
+        static inline bool block_equal(FingerprintType diff, size_t t) {
+            FingerprintType mask = block_width(t) == 64 ? ~FingerprintType(0) :
+                                   ((FingerprintType(1) << block_width(t)) - 1) << block_low(t);
+            return (diff & mask) == 0;
+        }
+
+        size_t n_entries = 0;
+        std::array<std::vector<Entry>, n_tables> owned_tables; // build 构建时的内存表
+        std::array<const Entry *, n_tables> tables{};           // 指向内存表或者 mmap 的文件
+        void *mapped_address = nullptr;
+        size_t mapped_length = 0;
+
+        void unmap() {
+            if (mapped_address != nullptr) ::munmap(mapped_address, mapped_length);
+            mapped_address = nullptr;
+            mapped_length = 0;
+        }
+
+        // 在第 t 张表中查找, 结果追加到 result
+        void query_table(size_t t, FingerprintType fingerprint, std::vector<Label> &result) const {
+            const FingerprintType key = rotate_left(fingerprint, rotation(t));
+            const size_t shift = 64 - block_width(t);
+            const FingerprintType prefix = key >> shift;
+            const Entry *begin = tables[t], *end = tables[t] + n_entries;
+            const Entry *first = std::lower_bound(begin, end, prefix, [shift](const Entry &entry, FingerprintType p) {
+                return (entry.key >> shift) < p;
+            });
+            for (const Entry *entry = first; entry != end && (entry->key >> shift) == prefix; entry++) {
+                FingerprintType diff = entry->key ^ key;
+                if (static_cast<size_t>(__builtin_popcountll(diff)) > max_distance) continue;
+                // 只在第一个完全相同的 block 所在的表中返回
+                diff = rotate_right(diff, rotation(t));
+                bool reported = false;
+                for (size_t i = 0; i < t && !reported; i++) reported = block_equal(diff, i);
+                if (!reported) result.push_back(entry->label);
+            }
+        }
+
+    public:
+        explicit HammingIndex() = default;
+
+        HammingIndex(const HammingIndex &) = delete;
+
+        HammingIndex &operator=(const HammingIndex &) = delete;
+
+        ~HammingIndex() { unmap(); }
+
+        [[nodiscard]] size_t size() const { return n_entries; }
+
+        // 批量构建索引, 覆盖之前的内容. 每张表独立排序, 表之间并行.
+        void build(const std::vector<FingerprintType> &fingerprints, const std::vector<Label> &labels) {
+            assert(fingerprints.size() == labels.size());
+            unmap();
+            n_entries = fingerprints.size();
+#pragma omp parallel for schedule(dynamic)
+            for (size_t t = 0; t < n_tables; t++) {
+                auto &table = owned_tables[t];
+                table.resize(n_entries);
+                for (size_t i = 0; i < n_entries; i++) {
+                    table[i] = Entry{rotate_left(fingerprints[i], rotation(t)), labels[i]};
+                }
+                auto compare = [](const Entry &a, const Entry &b) { return a.key < b.key; };
+#ifdef USE_CXX_PARALLISM_TS
+                std::sort(std::execution::par, table.begin(), table.end(), compare);
+#else
+                std::sort(table.begin(), table.end(), compare);
+#endif
+                tables[t] = table.data();
+            }
+        }
+
+        // 查询所有汉明距离 <= max_distance 的指纹的 label (没有重复)
+        std::vector<Label> query(FingerprintType fingerprint) const {
+            std::vector<Label> result;
+            for (size_t t = 0; t < n_tables; t++) query_table(t, fingerprint, result);
+            return result;
+        }
+
+        // 批量查询, 多个查询之间并行
+        std::vector<std::vector<Label>> query(const std::vector<FingerprintType> &fingerprints) const {
+            std::vector<std::vector<Label>> result(fingerprints.size());
+#pragma omp parallel for schedule(dynamic, 64)
+            for (size_t i = 0; i < fingerprints.size(); i++) {
+                for (size_t t = 0; t < n_tables; t++) query_table(t, fingerprints[i], result[i]);
+            }
+            return result;
+        }
+
+        // 保存为索引文件: 文件头 + n_tables 张已排序的表. 失败时抛出 std::system_error.
+        void save(const std::string &path) const {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            if (!out) throw_io_error("create", path);
+            FileHeader header{};
+            std::memcpy(header.magic, file_magic, sizeof(file_magic));
+            header.version = file_version;
+            header.distance = max_distance;
+            header.entry_size = sizeof(Entry);
+            header.size = n_entries;
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            for (size_t t = 0; t < n_tables; t++) {
+                out.write(reinterpret_cast<const char *>(tables[t]),
+                          static_cast<std::streamsize>(n_entries * sizeof(Entry)));
+            }
+            out.close();
+            if (!out) throw_io_error("write", path);
+        }
+
+        /**
+         * mmap 索引文件, 覆盖之前的内容. 文件在索引析构 (或者下一次 build / load) 之前不能被修改.
+         * 打开 / mmap 失败时抛出 std::system_error, 文件头和 HammingIndex 不一致 (或者长度不对) 时抛出 std::runtime_error,
+         * 失败时之前的内容不变.
+         */
+        void load(const std::string &path) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) throw_io_error("open", path);
+            struct stat file_stat{};
+            if (::fstat(fd, &file_stat) != 0) {
+                int error = errno;
+                ::close(fd);
+                errno = error;
+                throw_io_error("stat", path);
+            }
+            auto length = static_cast<size_t>(file_stat.st_size);
+            FileHeader header{};
+            // 先检查 header.size 不超过文件能容纳的条目数, 再计算期望长度, 损坏的文件头不会让乘法溢出
+            bool valid = length >= sizeof(FileHeader) && ::pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+                         std::memcmp(header.magic, file_magic, sizeof(file_magic)) == 0 &&
+                         header.version == file_version && header.distance == max_distance &&
+                         header.entry_size == sizeof(Entry) &&
+                         header.size <= (length - sizeof(FileHeader)) / (n_tables * sizeof(Entry)) &&
+                         length == sizeof(FileHeader) + n_tables * header.size * sizeof(Entry);
+            if (!valid) {
+                ::close(fd);
+                throw std::runtime_error("hamming index file " + path + " does not match HammingIndex<" +
+                                         std::to_string(max_distance) + ", label size " +
+                                         std::to_string(sizeof(Label)) + ">");
+            }
+            void *address = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+            int error = errno;
+            ::close(fd);
+            if (address == MAP_FAILED) {
+                errno = error;
+                throw_io_error("mmap", path);
+            }
+            ::madvise(address, length, MADV_RANDOM); // 查询是随机的二分查找
+            unmap();
+            for (auto &table : owned_tables) std::vector<Entry>().swap(table);
+            mapped_address = address;
+            mapped_length = length;
+            n_entries = header.size;
+            const auto *entries = reinterpret_cast<const Entry *>(static_cast<const char *>(address) +
+                                                                  sizeof(FileHeader));
+            for (size_t t = 0; t < n_tables; t++) tables[t] = entries + t * n_entries;
+        }
+
+        void print_config() const {
+            std::cout << "===============  Hamming index config  ===============\n";
+            std::cout << "max distance : " << max_distance << "  tables : " << n_tables << "  size : " << n_entries
+                      << "  storage : " << (mapped_address != nullptr ? "mmap" : "memory") << "\n";
+        }
+    };
+}
+#endif //LSH_CPP_HAMMING_INDEX_H
@@ -197,6 +197,56 @@ namespace LSH_CPP {
         return dna;
     }
 
+    // 单个碱基的 2-bit 编码, 与 dna_shingling_encode 一致: A=00, T=01, C=10, G=11. 其他字符返回 -1.
+    inline int dna_base_code(char ch) {
+        switch (ch) {
+            case 'A':
+                return 0;
+            case 'T':
+                return 1;
+            case 'C':
+                return 2;
+            case 'G':
+                return 3;
+            default:
+                return -1;
+        }
+    }
+
+    /**
+     * 滚动计算 read 中所有 k-mer 的 2-bit 编码并计数, 返回按编码递增排序的 { code, count }.
+     * code 和 dna_shingling_encode<k>(k_mer).to_ulong() 相同(第一个碱基在最高位), 可以直接作为 4^k 维权重向量的下标,
+     * 每个 k-mer 只需要一次移位和一次或运算, 不需要构造 bitset 和哈希表.
+     * 含有非 ACGT 字符的 k-mer 会被跳过; 长度小于 k 的 read 返回空结果.
+     */
+    template<size_t k>
+    std::vector<std::pair<uint64_t, uint32_t>> dna_kmer_code_count(const std::string_view &string) {
+        static_assert(k > 0 && k <= 32, "k-mer 2-bit code must fit in uint64_t.");
+        constexpr uint64_t mask = (k == 32) ? ~uint64_t(0) : ((uint64_t(1) << (2 * k)) - 1);
+        std::vector<uint64_t> codes;
+        if (string.size() >= k) codes.reserve(string.size() - k + 1);
+        uint64_t code = 0;
+        size_t valid = 0; // 当前窗口中连续合法碱基的个数
+        for (const auto &ch : string) {
+            int base = dna_base_code(ch);
+            if (base < 0) {
+                valid = 0;
+                continue;
+            }
+            code = ((code << 2u) | static_cast<uint64_t>(base)) & mask;
+            if (++valid >= k) codes.push_back(code);
+        }
+        std::sort(codes.begin(), codes.end());
+        std::vector<std::pair<uint64_t, uint32_t>> result;
+        for (size_t i = 0; i < codes.size();) {
+            size_t j = i;
+            while (j < codes.size() && codes[j] == codes[i]) j++;
+            result.emplace_back(codes[i], static_cast<uint32_t>(j - i));
+            i = j;
+        }
+        return result;
+    }
+
     template<size_t k, auto flag>
     HashSet <DNA_Shingling<k, flag>> split_dna_shingling(const std::string_view &string) {
         if (k >= string.size()) { // 这里的string.size()虽然是constexpr,但只有当string是编译期确定才有效.所以不能用if constexpr.
@@ -0,0 +1,150 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_KMER_NATURAL_VECTOR_H
+#define LSH_CPP_KMER_NATURAL_VECTOR_H
+
+#include "lsh_cpp.h"
+#include "k_shingles.h"
+#include "lsh_cosine_similarity.h"
+#include "hamming_index.h"
+
+namespace LSH_CPP {
+    /**
+     * k-mer natural vector.
+     * 参考: Wen et al., "K-mer natural vector and its application to the phylogenetic analysis of genetic sequences",
+     * Gene 2014.
+     *
+     * 对长度为 N 的序列和每个出现过的 k-mer l (位置 p_1, ..., p_{n_l}, 从 1 开始):
+     *   n_l  = 出现次数
+     *   μ_l  = \sum_i p_i / n_l                         (平均位置)
+     *   D_l  = \sum_i (p_i - μ_l)^2 / (n_l * N)          (归一化的二阶中心矩)
+     * 完整的 natural vector 是 3 * 4^k 维的 (n_l, μ_l, D_l), 没有出现的 k-mer 三个分量都是 0, 所以这里只保存出现过的 k-mer.
+     * 与 k-mer 计数相比, μ_l 和 D_l 额外描述了 k-mer 在序列中的分布, 计数相同但分布不同的序列可以被区分开.
+     */
+    struct KmerNaturalVector {
+        struct Component {
+            uint64_t code;   // k-mer 的 2-bit 编码, 与 dna_kmer_code_count 相同
+            uint32_t count;  // n_l
+            float mean;      // μ_l
+            float moment;    // D_l
+        };
+
+        size_t length = 0; // 序列长度 N
+        std::vector<Component> components; // 按 code 递增排序
+
+        /**
+         * 转换为 3 * 4^k 维的稀疏权重向量 { 3 * code + {0,1,2}, value }, 可以直接作为 SimHash 的输入.
+         * 三个分量分别为 scale[0] * n_l, scale[1] * μ_l / N, scale[2] * D_l. μ_l 与 N 同量级, 所以先除以 N,
+         * 使不同长度的序列可以比较; scale 用于调整三个分量在余弦 / 欧氏距离中的比重.
+         */
+        [[nodiscard]] std::vector<std::pair<uint64_t, float>>
+        to_sparse_vector(std::array<float, 3> scale = {1.0f, 1.0f, 1.0f}) const {
+            if (length > 0) scale[1] /= static_cast<float>(length);
+            std::vector<std::pair<uint64_t, float>> result;
+            result.reserve(3 * components.size());
+            for (const auto &component : components) {
+                result.emplace_back(3 * component.code, scale[0] * static_cast<float>(component.count));
+                result.emplace_back(3 * component.code + 1, scale[1] * component.mean);
+                result.emplace_back(3 * component.code + 2, scale[2] * component.moment);
+            }
+            return result;
+        }
+    };
+
+    /**
+     * 单次遍历计算 read 的 k-mer natural vector: 滚动计算 2-bit 编码 (和 dna_kmer_code_count 相同),
+     * 记录 { code, position }, 按 code 排序以后对每个 k-mer 累加 \sum p 和 \sum p^2,
+     * 然后 D_l = (\sum p^2 - n_l * μ_l^2) / (n_l * N). 不需要构造 bitset 和哈希表.
+     * 位置是 k-mer 第一个碱基的位置; 含有非 ACGT 字符的 k-mer 会被跳过.
+     */
+    template<size_t k>
+    KmerNaturalVector kmer_natural_vector(const std::string_view &string) {
+        static_assert(k > 0 && k <= 32, "k-mer 2-bit code must fit in uint64_t.");
+        constexpr uint64_t mask = (k == 32) ? ~uint64_t(0) : ((uint64_t(1) << (2 * k)) - 1);
+        std::vector<std::pair<uint64_t, uint32_t>> codes; // { code, position }
+        if (string.size() >= k) codes.reserve(string.size() - k + 1);
+        uint64_t code = 0;
+        size_t valid = 0;
+        for (size_t i = 0; i < string.size(); i++) {
+            int base = dna_base_code(string[i]);
+            if (base < 0) {
+                valid = 0;
+                continue;
+            }
+            code = ((code << 2u) | static_cast<uint64_t>(base)) & mask;
+            if (++valid >= k) codes.emplace_back(code, static_cast<uint32_t>(i + 2 - k)); // 从 1 开始的位置
+        }
+        std::sort(codes.begin(), codes.end());
+        KmerNaturalVector result;
+        result.length = string.size();
+        const auto length = static_cast<double>(string.size());
+        for (size_t i = 0; i < codes.size();) {
+            size_t j = i;
+            double sum = 0, square_sum = 0;
+            for (; j < codes.size() && codes[j].first == codes[i].first; j++) {
+                auto position = static_cast<double>(codes[j].second);
+                sum += position;
+                square_sum += position * position;
+            }
+            auto count = static_cast<double>(j - i);
+            double mean = sum / count;
+            double moment = std::max(0.0, square_sum - count * mean * mean) / (count * length);
+            result.components.push_back({codes[i].first, static_cast<uint32_t>(j - i), static_cast<float>(mean),
+                                         static_cast<float>(moment)});
+            i = j;
+        }
+        return result;
+    }
+
+    /**
+     * 基于 k-mer natural vector 的余弦近邻索引: 每条 read 的 natural vector 经过 SimHash<64> 得到 64 位指纹
+     * (一批 read 一次稀疏 GEMM), 然后用 HammingIndex 查询汉明距离 <= max_distance 的指纹,
+     * 即估计夹角不超过 max_distance / 64 * π 的 read. 避免了 O(n^2) 的两两余弦相似度计算.
+     * 查询得到的是候选集, 需要精确结果时再用 cosine_similarity 验证 (欧氏距离可以在 scale 归一化后同样验证).
+     */
+    template<size_t k, size_t max_distance = 3, typename Label = size_t, size_t seed = 1>
+    class NaturalVectorIndex {
+    public:
+        using SimHashType = SimHash<64, seed>;
+        static constexpr size_t dim = 3 * (size_t(1) << (2 * k));
+
+    private:
+        std::array<float, 3> scale;
+        SimHashType simhash;
+        HammingIndex<max_distance, Label> index;
+
+    public:
+        explicit NaturalVectorIndex(std::array<float, 3> scale = {1.0f, 1.0f, 1.0f})
+                : scale(scale), simhash(dim) {}
+
+        // 一批 read 的 64 位指纹
+        std::vector<uint64_t> fingerprints(const std::vector<std::string> &reads) const {
+            std::vector<std::vector<std::pair<uint64_t, float>>> batch(reads.size());
+#pragma omp parallel for schedule(dynamic, 64)
+            for (size_t i = 0; i < reads.size(); i++) {
+                batch[i] = kmer_natural_vector<k>(reads[i]).to_sparse_vector(scale);
+            }
+            std::vector<uint64_t> result;
+            result.reserve(reads.size());
+            for (const auto &value : simhash.sketch_batch(batch)) result.push_back(value[0]);
+            return result;
+        }
+
+        void build(const std::vector<std::string> &reads, const std::vector<Label> &labels) {
+            index.build(fingerprints(reads), labels);
+        }
+
+        std::vector<std::vector<Label>> query(const std::vector<std::string> &reads) const {
+            return index.query(fingerprints(reads));
+        }
+
+        void save(const std::string &path) const { index.save(path); }
+
+        void load(const std::string &path) { index.load(path); }
+
+        [[nodiscard]] size_t size() const { return index.size(); }
+    };
+}
+#endif //LSH_CPP_KMER_NATURAL_VECTOR_H
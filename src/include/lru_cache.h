@@ -73,5 +73,60 @@ namespace LSH_CPP {
             }
         }
     };
+
+    /**
+     * 多线程共享的 lru_cache: 按 key 分成 n_shards 个分片, 每个分片是一个带互斥锁的 lru_cache,
+     * 容量为 max_size / n_shards, 所以总内存和单个 lru_cache(max_size) 相同, 不随线程个数增长.
+     * 不同分片之间没有竞争; get 返回值的拷贝, 锁只在查找/插入期间持有.
+     */
+    template<
+            typename K,
+            typename V,
+            typename Hash,
+            typename Eq,
+            template<typename/*Alloc Element*/> typename Alloc,
+            template<typename/*K*/, typename/*V*/, typename /*Hash*/, typename /*Eq*/, typename /*Alloc*/> typename Map,
+            size_t n_shards = 16
+    >
+    class concurrent_lru_cache {
+    private:
+        struct Shard {
+            std::mutex mutex;
+            lru_cache<K, V, Hash, Eq, Alloc, Map> cache;
+
+            explicit Shard(size_t max_size) : cache(max_size) {}
+        };
+
+        size_t _max_size;
+        std::vector<std::unique_ptr<Shard>> shards;
+
+        // 用 Hash 的高位选择分片 (乘法混合一次), 分片内的 Map 仍然使用完整的哈希值
+        Shard &shard_of(const K &key) {
+            auto hash = static_cast<uint64_t>(Hash{}(key)) * 0x9E3779B97F4A7C15ull;
+            return *shards[(hash >> 32u) % n_shards];
+        }
+
+    public:
+        explicit concurrent_lru_cache(size_t _max_size) : _max_size(_max_size) {
+            shards.reserve(n_shards);
+            for (size_t i = 0; i < n_shards; i++) {
+                shards.push_back(std::make_unique<Shard>(std::max<size_t>(1, _max_size / n_shards)));
+            }
+        }
+
+        [[nodiscard]] size_t max_size() const { return _max_size; }
+
+        void put(const K &key, const V &value) {
+            auto &shard = shard_of(key);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.cache.put(key, value);
+        }
+
+        std::optional<V> get(const K &key) {
+            auto &shard = shard_of(key);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            return shard.cache.get(key);
+        }
+    };
 }
 #endif //LSH_CPP_LRU_CACHE_H
@@ -7,10 +7,43 @@
 
 #include "lsh_cpp.h"
 #include "minhash.h"
+#include "weight_minhash.h"
+#include "super_minhash.h"
 #include "util.h"
 #include "hash.h"
+#include "posting_list.h"
 
 namespace LSH_CPP {
+    /**
+     * 根据 threshold 和 weights 优化 LSH 参数 {b, r}, 使加权后的 false positive / false negative 概率积分最小.
+     * (LSH / ExternalLSH 等索引实现共用这一个参数优化过程)
+     */
+    inline std::pair<size_t, size_t>
+    lsh_optimal_params(size_t n_permutation, double threshold, const std::pair<double, double> &weights) {
+        auto[false_positive_weight, false_negative_weight] = weights; // C++17 特性: auto[a,b] = std::pair<A,B>{a_val,b_val};
+        double temp_params[2];
+        double min_error = std::numeric_limits<double>::max();
+        std::pair<size_t, size_t> ret;
+        for (size_t _b = 1; _b <= n_permutation; _b++) {
+            size_t max_r = n_permutation / _b;
+            temp_params[0] = _b;
+            for (size_t _r = 1; _r <= max_r; _r++) {
+                temp_params[1] = _r;
+                auto false_positive = numerical_integration
+                        (false_positive_probability, {0.0, threshold}, temp_params);
+                auto false_negative = numerical_integration
+                        (false_negative_probability, {threshold, 1.0}, temp_params);
+                auto error = false_positive_weight * false_positive + false_negative_weight * false_negative;
+                if (error < min_error) {
+                    min_error = error;
+                    ret.first = _b;
+                    ret.second = _r;
+                }
+            }
+        }
+        return ret;
+    }
+
     /**
      *
      * @tparam BandHashFunc 可以将Band中r个min_hash_value哈希为一个整数(uint64_t),作为当前Band哈希表的key
@@ -22,13 +55,16 @@ namespace LSH_CPP {
      * @tparam b number of bands
      * @tparam r number of rows in one band
      * @tparam n_permutation
+     * @tparam Bucket 每个 band 哈希表的 value 类型(持有 label 的 posting list).
+     * 默认是 std::vector<MinHashLabel>; 整数 label 可以用 CompressedPostingList<MinHashLabel> 压缩 band 表的内存.
      */
     template<
             typename BandHashFunc = XXUInt64Hash64,
             typename MinHashLabel = std::string_view,
             size_t b = 0,
             size_t r = 0,
-            size_t n_permutation = 128
+            size_t n_permutation = 128,
+            typename Bucket = std::vector<MinHashLabel>
     >
     class LSH {
     public:
@@ -37,7 +73,7 @@ namespace LSH_CPP {
 
         // BandHashMap以min_hash所在data的label作为value.因为需要通过冲突来寻找相似集合,
         // 所以实际的BandHashValueType是MinHashLabel集合
-        using BandHashValueType = std::vector<MinHashLabel>;
+        using BandHashValueType = Bucket;
 
         using BandHashMap = HashMap<BandHashKeyType, BandHashValueType>;
 
@@ -53,39 +89,13 @@ namespace LSH_CPP {
         // TODO: 引入 std::vector<MinHashLabel> data_set; 来检查有没有重复插入同一个data,但感觉不是特别必要...
         //      std::vector<MinHashLabel> data_set;
 
-        std::pair<size_t, size_t>
-        optimal_params(double threshold, const std::pair<false_positive_weight, false_negative_weight> &weights) {
-            auto[false_positive_weight, false_negative_weight] = weights; // C++17 特性: auto[a,b] = std::pair<A,B>{a_val,b_val};
-            double temp_params[2];
-            double min_error = std::numeric_limits<double>::max();
-            std::pair<size_t, size_t> ret;
-            for (size_t _b = 1; _b <= n_permutation; _b++) {
-                size_t max_r = n_permutation / _b;
-                temp_params[0] = _b;
-                for (size_t _r = 1; _r <= max_r; _r++) {
-                    temp_params[1] = _r;
-                    auto false_positive = numerical_integration
-                            (false_positive_probability, {0.0, threshold}, temp_params);
-                    auto false_negative = numerical_integration
-                            (false_negative_probability, {threshold, 1.0}, temp_params);
-                    auto error = false_positive_weight * false_positive + false_negative_weight * false_negative;
-                    if (error < min_error) {
-                        min_error = error;
-                        ret.first = _b;
-                        ret.second = _r;
-                    }
-                }
-            }
-            return ret;
-        }
-
     public:
         /**
          * @param params = { b , r }
          * @param threshold: Jaccard similarity threshold. 0.0 <= threshold <= 1.0
          * @param weights: { false_positive_weight, false_negative_weight }. weights.first + weights.second = 1.0.
          * 比重给的越大,代表越希望减少这个方面的误差,比如极限情况下设置 { 0,1 }
-         * 此时仅保留false_negative_weight,然后调用optimal_params(..)不断以减少false_negative_error去优化参数.
+         * 此时仅保留false_negative_weight,然后调用lsh_optimal_params(..)不断以减少false_negative_error去优化参数.
          */
         explicit LSH(double threshold = 0.9,
                      std::pair<false_positive_weight, false_negative_weight> weights = {0.5, 0.5}) {
@@ -101,7 +111,7 @@ namespace LSH_CPP {
             } else {
                 // 根据 threshold 和 weights 得出优化的参数,保存在params.
                 // 注意后面都需要先在编译期判断{b,r}是否可用,不可用时再选择params(且没有运行开销).
-                params = optimal_params(threshold, weights);
+                params = lsh_optimal_params(n_permutation, threshold, weights);
                 band_hash_maps.resize(params.first, BandHashMap{});
                 for (size_t i = 0; i < params.first; i++) {
                     band_hash_range.push_back({i * params.second, (i + 1) * params.second});
@@ -109,12 +119,12 @@ namespace LSH_CPP {
             }
         }
 
-        template<typename HashFunc, size_t MinHashBits, size_t Seed, typename RandomGenerator>
-        void insert(const MinHash <HashFunc, MinHashBits, n_permutation, Seed, RandomGenerator> &min_hash,
-                    const MinHashLabel &label) {
+    private:
+        // band 哈希的公共实现: hash_values 是 n_permutation 个 uint64_t (MinHash 的最小哈希值或 WeightMinHash 的指纹)
+        void insert_hash_values(const std::vector<uint64_t> &hash_values, const MinHashLabel &label) {
             // TODO: 检查 label 代表的数据是不是重复插入
             for (size_t i = 0; i < band_hash_maps.size(); i++) {
-                auto key = bandHashFunc(min_hash.hash_values, band_hash_range[i]);
+                auto key = bandHashFunc(hash_values, band_hash_range[i]);
                 if (auto pos = band_hash_maps[i].find(key); pos == band_hash_maps[i].end()) { // c++17 if (init;cond)
                     band_hash_maps[i].try_emplace(key, BandHashValueType{label});
                 } else {
@@ -123,14 +133,12 @@ namespace LSH_CPP {
             }
         }
 
-        template<typename HashFunc, size_t MinHashBits, size_t Seed, typename RandomGenerator>
         HashSet <MinHashLabel>
-        query_then_insert(const MinHash <HashFunc, MinHashBits, n_permutation, Seed, RandomGenerator> &min_hash,
-                          const MinHashLabel &label) {
+        query_then_insert_hash_values(const std::vector<uint64_t> &hash_values, const MinHashLabel &label) {
             // TODO: 检查 label 代表的数据是不是重复插入
             HashSet<MinHashLabel> candidate_set;
             for (size_t i = 0; i < band_hash_maps.size(); i++) {
-                auto key = bandHashFunc(min_hash.hash_values, band_hash_range[i]);
+                auto key = bandHashFunc(hash_values, band_hash_range[i]);
                 if (auto pos = band_hash_maps[i].find(key); pos != band_hash_maps[i].end()) {
                     for (const auto &item : (*pos).second) {
                         candidate_set.insert(item);
@@ -143,12 +151,11 @@ namespace LSH_CPP {
             return candidate_set;
         }
 
-        template<typename HashFunc, size_t MinHashBits, size_t Seed, typename RandomGenerator>
         HashSet <MinHashLabel> // 用hash_set做返回值是为了过滤重复的candidate.
-        query(const MinHash <HashFunc, MinHashBits, n_permutation, Seed, RandomGenerator> &min_hash) {
+        query_hash_values(const std::vector<uint64_t> &hash_values) const {
             HashSet<MinHashLabel> candidate_set;
             for (size_t i = 0; i < band_hash_maps.size(); i++) {
-                auto key = bandHashFunc(min_hash.hash_values, band_hash_range[i]);
+                auto key = bandHashFunc(hash_values, band_hash_range[i]);
                 if (auto pos = band_hash_maps[i].find(key); pos != band_hash_maps[i].end()) {
                     for (const auto &item : (*pos).second) {
                         candidate_set.insert(item);
@@ -158,7 +165,112 @@ namespace LSH_CPP {
             return candidate_set;
         }
 
-        void print_config() {
+    public:
+        template<typename HashFunc, size_t MinHashBits, size_t Seed, typename RandomGenerator>
+        void insert(const MinHash <HashFunc, MinHashBits, n_permutation, Seed, RandomGenerator> &min_hash,
+                    const MinHashLabel &label) {
+            insert_hash_values(min_hash.hash_values, label);
+        }
+
+        template<typename HashFunc, size_t MinHashBits, size_t Seed, typename RandomGenerator>
+        HashSet <MinHashLabel>
+        query_then_insert(const MinHash <HashFunc, MinHashBits, n_permutation, Seed, RandomGenerator> &min_hash,
+                          const MinHashLabel &label) {
+            return query_then_insert_hash_values(min_hash.hash_values, label);
+        }
+
+        template<typename HashFunc, size_t MinHashBits, size_t Seed, typename RandomGenerator>
+        HashSet <MinHashLabel>
+        query(const MinHash <HashFunc, MinHashBits, n_permutation, Seed, RandomGenerator> &min_hash) const {
+            return query_hash_values(min_hash.hash_values);
+        }
+
+        // SuperMinHash 的 slot 值和 MinHash 的最小哈希值一样, 碰撞概率就是 jaccard similarity
+        template<typename HashFunc, size_t Seed>
+        void insert(const SuperMinHash<HashFunc, n_permutation, Seed> &super_minhash, const MinHashLabel &label) {
+            insert_hash_values(super_minhash.hash_values, label);
+        }
+
+        template<typename HashFunc, size_t Seed>
+        HashSet <MinHashLabel>
+        query_then_insert(const SuperMinHash<HashFunc, n_permutation, Seed> &super_minhash, const MinHashLabel &label) {
+            return query_then_insert_hash_values(super_minhash.hash_values, label);
+        }
+
+        template<typename HashFunc, size_t Seed>
+        HashSet <MinHashLabel> query(const SuperMinHash<HashFunc, n_permutation, Seed> &super_minhash) const {
+            return query_hash_values(super_minhash.hash_values);
+        }
+
+        // 带权重的 sketch: 用 (k*, t_k*) 的 64 位指纹代替最小哈希值做 band 哈希, 碰撞概率就是 generalized jaccard similarity,
+        // 所以同一套 {b, r} 参数可以直接用于 generalized jaccard 的查询. 要求 sample_size == n_permutation.
+        void insert(const PackedWeightMinHash<n_permutation, uint64_t> &weight_minhash, const MinHashLabel &label) {
+            insert_hash_values(weight_minhash.hash_values, label);
+        }
+
+        HashSet <MinHashLabel>
+        query_then_insert(const PackedWeightMinHash<n_permutation, uint64_t> &weight_minhash,
+                          const MinHashLabel &label) {
+            return query_then_insert_hash_values(weight_minhash.hash_values, label);
+        }
+
+        HashSet <MinHashLabel> query(const PackedWeightMinHash<n_permutation, uint64_t> &weight_minhash) const {
+            return query_hash_values(weight_minhash.hash_values);
+        }
+
+        template<size_t dim, typename T, size_t seed, typename RG>
+        void insert(const WeightMinHash<dim, T, n_permutation, seed, RG, void, void> &weight_minhash,
+                    const MinHashLabel &label) {
+            insert(PackedWeightMinHash<n_permutation, uint64_t>(weight_minhash), label);
+        }
+
+        template<size_t dim, typename T, size_t seed, typename RG>
+        HashSet <MinHashLabel>
+        query_then_insert(const WeightMinHash<dim, T, n_permutation, seed, RG, void, void> &weight_minhash,
+                          const MinHashLabel &label) {
+            return query_then_insert(PackedWeightMinHash<n_permutation, uint64_t>(weight_minhash), label);
+        }
+
+        template<size_t dim, typename T, size_t seed, typename RG>
+        HashSet <MinHashLabel>
+        query(const WeightMinHash<dim, T, n_permutation, seed, RG, void, void> &weight_minhash) const {
+            return query(PackedWeightMinHash<n_permutation, uint64_t>(weight_minhash));
+        }
+
+        // 释放 bucket 多余的 capacity, 适合在批量插入结束以后调用
+        void shrink_to_fit() {
+            for (auto &band_hash_map : band_hash_maps) {
+                for (auto &item : band_hash_map) item.second.shrink_to_fit();
+            }
+        }
+
+        // 估计 band 哈希表占用的内存字节数 (哈希表的 entry + 每个 bucket 的堆内存)
+        [[nodiscard]] size_t memory_usage() const {
+            size_t bytes = 0;
+            for (const auto &band_hash_map : band_hash_maps) {
+                bytes += band_hash_map.size() * sizeof(typename BandHashMap::value_type);
+                for (const auto &item : band_hash_map) bytes += bucket_heap_bytes(item.second);
+            }
+            return bytes;
+        }
+
+        // 所有 band 哈希表的 key (bucket) 总数
+        [[nodiscard]] size_t key_size() const {
+            size_t n = 0;
+            for (const auto &band_hash_map : band_hash_maps) n += band_hash_map.size();
+            return n;
+        }
+
+        // 所有 bucket 中的 label 总数, 等于插入次数 * band 数
+        [[nodiscard]] size_t label_size() const {
+            size_t n = 0;
+            for (const auto &band_hash_map : band_hash_maps) {
+                for (const auto &item : band_hash_map) n += item.second.size();
+            }
+            return n;
+        }
+
+        void print_config() const {
             std::cout << "===============  LSH config  ===============\n";
             std::cout << "params : b = " << params.first << "  r = " << params.second << "\n";
         }
@@ -4,10 +4,13 @@
 
 #ifndef LSH_CPP_LSH_COSINE_SIMILARITY_H
 #define LSH_CPP_LSH_COSINE_SIMILARITY_H
+
+#include "lsh_cpp.h"
+
 // 基于余弦相似度的 LSH 加速.
-// TODO: K-mer natural vector and its application to the phylogenetic analysis of genetic sequences
-//      构造 k-mer natural vector, 然后基于 cos similarity 计算相似度, 用 lsh 加速.
-//      用这种方法与 weight minhash 比较结果.
+// K-mer natural vector and its application to the phylogenetic analysis of genetic sequences
+//      构造 k-mer natural vector, 然后基于 cos similarity 计算相似度, 用 lsh 加速. (见 kmer_natural_vector.h)
+// TODO: 用这种方法与 weight minhash 比较结果.
 // TODO
 //      weight minhash 与 k-mer natural vector 都需要一个初始的全域向量(记录k_mer在sequence里出现的次数),
 //      而这个过程需要得到每一个k-mer的位置编码.
@@ -26,4 +29,183 @@
 //    但是它没有衡量一个序列中 k_mer 的分布是否相似. 仅仅衡量相似的k_mer个数是不够的, 还需要从空间上衡量相似度,
 //    这就是 k_mer natural vector 要解决的问题. 可以考虑引入一个权重决定两种相似度的比重,然后综合起来得到最后的相似度.
 
+namespace LSH_CPP {
+    template<size_t n_bits>
+    using SimHashValue = std::array<uint64_t, n_bits / 64>; // 每个超平面一位, 按 64 位一组打包
+
+    /**
+     * SimHash (random hyperplane LSH, Charikar 2002): 对随机高斯超平面 r, Pr[sign(r·x) != sign(r·y)] = θ(x,y) / π,
+     * 所以两个指纹的汉明距离 / n_bits 是夹角 θ / π 的无偏估计, cos(π * hamming / n_bits) 即为余弦相似度的估计.
+     *
+     * 超平面矩阵 hyperplanes (n_bits, dim) 由 seed 决定, 同一个 SimHash 对象可以被多线程共享 (只读).
+     * 批量计算时把一批向量按列拼成矩阵 X (dim, n), 一次 GEMM (MKL) 得到所有投影 P = hyperplanes * X (n_bits, n),
+     * 然后按列取符号位打包, 比逐个向量做矩阵-向量乘法快得多. 每次最多处理 batch_size 列, 限制 P 的内存.
+     * 注意 hyperplanes 是稠密矩阵, 占用 n_bits * dim * 4 字节, dim 很大的稀疏向量(比如 TF-IDF)需要先做特征哈希降维.
+     */
+    template<size_t n_bits = 256, size_t seed = 1>
+    class SimHash {
+        static_assert(n_bits > 0 && n_bits % 64 == 0, "n_bits should be a multiple of 64.");
+    public:
+        using HashValue = SimHashValue<n_bits>;
+        using Matrix = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic>;
+        using Vector = Eigen::Matrix<float, Eigen::Dynamic, 1>;
+        using SparseMatrix = Eigen::SparseMatrix<float>; // column major, 每一列是一个向量
+        static constexpr size_t n_words = n_bits / 64;
+        static constexpr size_t batch_size = 4096;
+
+    private:
+        size_t dim;
+        Matrix hyperplanes;
+
+        // 把投影矩阵 projection (n_bits, n) 的每一列按符号打包, 写入 result[offset, offset + n)
+        static void pack_sign_bits(const Matrix &projection, std::vector<HashValue> &result, size_t offset) {
+            for (Eigen::Index col = 0; col < projection.cols(); col++) {
+                const float *p = projection.data() + col * projection.rows();
+                HashValue &value = result[offset + col];
+                for (size_t word = 0; word < n_words; word++) {
+                    uint64_t bits = 0;
+#ifdef __AVX2__
+                    const __m256 zero = _mm256_setzero_ps();
+                    for (size_t i = 0; i < 64; i += 8) {
+                        // 和标量代码相同的规则: 投影 >= 0 的位为 1 (-0.0 也是 1, NaN 为 0), 不能直接取符号位
+                        __m256 ge = _mm256_cmp_ps(_mm256_loadu_ps(p + word * 64 + i), zero, _CMP_GE_OQ);
+                        bits |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_ps(ge))) << i;
+                    }
+#else
+                    for (size_t i = 0; i < 64; i++) {
+                        if (p[word * 64 + i] >= 0) bits |= uint64_t(1) << i;
+                    }
+#endif
+                    value[word] = bits;
+                }
+            }
+        }
+
+    public:
+        explicit SimHash(size_t dim) : dim(dim), hyperplanes(n_bits, dim) {
+            std::mt19937_64 generator(seed);
+            std::normal_distribution<float> distribution(0, 1);
+            for (Eigen::Index col = 0; col < hyperplanes.cols(); col++) {
+                for (Eigen::Index row = 0; row < hyperplanes.rows(); row++) {
+                    hyperplanes(row, col) = distribution(generator);
+                }
+            }
+        }
+
+        [[nodiscard]] size_t dimension() const { return dim; }
+
+        // 单个稠密向量 (GEMV)
+        HashValue sketch(const Vector &vector) const {
+            assert(static_cast<size_t>(vector.size()) == dim);
+            std::vector<HashValue> result(1);
+            Matrix projection = hyperplanes * vector;
+            pack_sign_bits(projection, result, 0);
+            return result[0];
+        }
+
+        HashValue sketch(const std::vector<float> &vector) const {
+            return sketch(Eigen::Map<const Vector>(vector.data(), vector.size()));
+        }
+
+        // 单个稀疏向量 { index, weight }, 只累加非0维度对应的超平面列
+        template<typename Index, typename WeightType,
+                typename = std::enable_if_t<std::is_integral_v<Index> && std::is_arithmetic_v<WeightType>>>
+        HashValue sketch(const std::vector<std::pair<Index, WeightType>> &sparse_vector) const {
+            std::vector<HashValue> result(1);
+            Matrix projection = Matrix::Zero(n_bits, 1);
+            for (const auto &[index, weight] : sparse_vector) {
+                assert(static_cast<size_t>(index) < dim);
+                projection.col(0) += static_cast<float>(weight) * hyperplanes.col(static_cast<Eigen::Index>(index));
+            }
+            pack_sign_bits(projection, result, 0);
+            return result[0];
+        }
+
+        // 批量稠密向量, batch 的每一列是一个向量 (dim, n)
+        std::vector<HashValue> sketch_batch(const Matrix &batch) const {
+            assert(static_cast<size_t>(batch.rows()) == dim);
+            std::vector<HashValue> result(batch.cols());
+            Matrix projection;
+            for (Eigen::Index begin = 0; begin < batch.cols(); begin += batch_size) {
+                Eigen::Index n = std::min<Eigen::Index>(batch_size, batch.cols() - begin);
+                projection.noalias() = hyperplanes * batch.middleCols(begin, n);
+                pack_sign_bits(projection, result, begin);
+            }
+            return result;
+        }
+
+        // 批量稀疏向量, batch 的每一列是一个向量 (dim, n)
+        std::vector<HashValue> sketch_batch(const SparseMatrix &batch) const {
+            assert(static_cast<size_t>(batch.rows()) == dim);
+            std::vector<HashValue> result(batch.cols());
+            Matrix projection;
+            for (Eigen::Index begin = 0; begin < batch.cols(); begin += batch_size) {
+                Eigen::Index n = std::min<Eigen::Index>(batch_size, batch.cols() - begin);
+                projection.noalias() = hyperplanes * batch.middleCols(begin, n);
+                pack_sign_bits(projection, result, begin);
+            }
+            return result;
+        }
+
+        // 批量稀疏向量 { index, weight }, 比如一批 read 的 dna_kmer_code_count 结果, 先组装成稀疏矩阵再计算
+        template<typename Index, typename WeightType,
+                typename = std::enable_if_t<std::is_integral_v<Index> && std::is_arithmetic_v<WeightType>>>
+        std::vector<HashValue> sketch_batch(const std::vector<std::vector<std::pair<Index, WeightType>>> &batch) const {
+            std::vector<Eigen::Triplet<float>> triplets;
+            for (size_t col = 0; col < batch.size(); col++) {
+                for (const auto &[index, weight] : batch[col]) {
+                    assert(static_cast<size_t>(index) < dim);
+                    triplets.emplace_back(static_cast<int>(index), static_cast<int>(col), static_cast<float>(weight));
+                }
+            }
+            SparseMatrix matrix(dim, batch.size());
+            matrix.setFromTriplets(triplets.begin(), triplets.end());
+            return sketch_batch(matrix);
+        }
+    };
+
+    template<size_t n_words>
+    size_t hamming_distance(const std::array<uint64_t, n_words> &A, const std::array<uint64_t, n_words> &B) {
+        size_t distance = 0;
+        for (size_t i = 0; i < A.size(); i++) distance += __builtin_popcountll(A[i] ^ B[i]);
+        return distance;
+    }
+
+    // 由 SimHash 指纹估计余弦相似度: cos(π * hamming / n_bits)
+    template<size_t n_words>
+    double simhash_cosine_similarity(const std::array<uint64_t, n_words> &A, const std::array<uint64_t, n_words> &B) {
+        return std::cos(M_PI * (double) hamming_distance(A, B) / (double) (n_words * 64));
+    }
+
+    // 稠密向量实际的余弦相似度
+    template<typename WeightType, typename = std::enable_if_t<std::is_arithmetic_v<WeightType>>>
+    double cosine_similarity(const std::vector<WeightType> &A, const std::vector<WeightType> &B) {
+        assert(A.size() == B.size());
+        double dot = 0, norm_a = 0, norm_b = 0;
+        for (size_t i = 0; i < A.size(); i++) {
+            dot += (double) A[i] * B[i];
+            norm_a += (double) A[i] * A[i];
+            norm_b += (double) B[i] * B[i];
+        }
+        return dot / std::sqrt(norm_a * norm_b);
+    }
+
+    // 稀疏向量 { index, weight } (按 index 递增排序) 实际的余弦相似度
+    template<typename Index, typename WeightType,
+            typename = std::enable_if_t<std::is_integral_v<Index> && std::is_arithmetic_v<WeightType>>>
+    double cosine_similarity(const std::vector<std::pair<Index, WeightType>> &A,
+                             const std::vector<std::pair<Index, WeightType>> &B) {
+        double dot = 0, norm_a = 0, norm_b = 0;
+        for (const auto &[index, weight] : A) norm_a += (double) weight * weight;
+        for (const auto &[index, weight] : B) norm_b += (double) weight * weight;
+        size_t i = 0, j = 0;
+        while (i < A.size() && j < B.size()) {
+            if (A[i].first < B[j].first) i++;
+            else if (B[j].first < A[i].first) j++;
+            else dot += (double) A[i++].second * B[j++].second;
+        }
+        return dot / std::sqrt(norm_a * norm_b);
+    }
+}
+
 #endif //LSH_CPP_LSH_COSINE_SIMILARITY_H
@@ -34,18 +34,32 @@
 
 // C++ std include
 #include <vector>
+#include <deque>
+#include <queue>
 #include <map>
 #include <unordered_map>
 #include <set>
 #include <unordered_set>
 #include <bitset>
 #include <algorithm>
+#include <numeric>
 #include <utility>
 #include <memory>
 #include <functional>
 #include <chrono>
 #include <random>
 #include <limits>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <future>
+#include <optional>
+#include <array>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
 
 #ifdef USE_CXX_PARALLISM_TS
 
@@ -57,10 +71,27 @@
 #include <cstdint>
 #include <cstdio>
 #include <cstddef>
+#include <cstring>
+#include <cerrno>
 #include <ctime>
 #include <cmath>
 #include <cassert>
 
+// SIMD include
+#ifdef __AVX2__
+
+#include <immintrin.h>
+
+#endif
+
+// POSIX include (mmap / pread 等磁盘索引相关, socketpair / fork 等多进程分片相关)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
 // Third party include
 
 // phmap默认不使用带随机因子的哈希,所以这里不需要显式设置NON_DETERMINISTIC为0.(当前场景不需要随机性的哈希).
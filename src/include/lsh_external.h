@@ -0,0 +1,373 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_LSH_EXTERNAL_H
+#define LSH_CPP_LSH_EXTERNAL_H
+
+#include "lsh_cpp.h"
+#include "util.h"
+#include "hash.h"
+#include "minhash.h"
+#include "lsh.h"
+
+namespace LSH_CPP {
+    /**
+     * 外存(out-of-core) LSH 索引. 接口和 LSH 一致 (insert / query), 但 band 哈希表超过内存预算时会溢写到磁盘.
+     *
+     * 每个 band 是一个 partition, 由两部分组成:
+     *   1. 内存部分: HashMap<key, std::vector<label>>, 新插入的数据都先写到这里;
+     *   2. 磁盘部分: 若干个按 key 排序的 run 文件 (Record 数组), 通过 mmap 只读映射.
+     * 所有 band 内存部分的记录总数超过 max_memory_records 时, 把内存记录最多的 band 排序后整体写成一个新的 run,
+     * 然后清空它的内存部分.
+     * run 按 size-tiered 方式归并: 溢写出的 run 是第 0 层, 同一层攒够 merge_fan_in 个 run 时把这几个 run
+     * 多路归并成一个上一层的 run (可能继续向上进位, 类似二进制计数器). 已经归并过的大 run 只有在同层 run 凑齐时
+     * 才会被重写, 每条记录最多被重写 log_{fan_in}(band 记录数 / 溢写大小) 次, 总写入量是 O(N log N) 而不是
+     * 每次都全部重写的 O(N^2). 每个 band 每层最多 merge_fan_in - 1 个 run, 查询时二分查找的次数同样是对数级.
+     * 查询时合并内存部分和所有 run 中 key 相同的 label.
+     * run 文件是临时文件, 索引析构时删除. 文件名带有 "进程号_实例号" 前缀, 多个索引 (包括多个进程) 可以共用同一个目录.
+     * 磁盘 I/O 出错时抛出 std::system_error (包含 errno 和文件路径), 这时已经插入的数据仍然保留在索引中:
+     * 溢写失败的 band 保留内存部分, 归并失败的 band 保留原来的 run.
+     *
+     * @tparam MinHashLabel 必须是 trivially copyable 的类型 (一般是整数编号), 因为 run 文件直接保存 Record 的二进制.
+     */
+    template<
+            typename BandHashFunc = XXUInt64Hash64,
+            typename MinHashLabel = size_t,
+            size_t b = 0,
+            size_t r = 0,
+            size_t n_permutation = 128
+    >
+    class ExternalLSH {
+        static_assert(std::is_trivially_copyable_v<MinHashLabel>,
+                      "ExternalLSH only supports trivially copyable label.");
+    public:
+        using BandHashKeyType = uint64_t;
+        using false_positive_weight = double;
+        using false_negative_weight = double;
+
+        struct Record {
+            BandHashKeyType key;
+            MinHashLabel label;
+        };
+
+    private:
+        [[noreturn]] static void throw_io_error(const char *operation, const std::string &path) {
+            throw std::system_error(errno, std::generic_category(), std::string(operation) + " run file " + path);
+        }
+
+        // 磁盘上一个按 key 排序的 run 文件. 析构时解除映射并删除文件; 构造失败时也删除文件.
+        class Run {
+        private:
+            std::string path;
+            const Record *records = nullptr;
+            size_t n_records = 0;
+
+        public:
+            explicit Run(std::string run_path) : path(std::move(run_path)) {
+                int fd = ::open(path.c_str(), O_RDONLY);
+                struct stat file_stat{};
+                if (fd < 0 || ::fstat(fd, &file_stat) < 0) fail(fd, "open");
+                n_records = static_cast<size_t>(file_stat.st_size) / sizeof(Record);
+                if (n_records > 0) {
+                    void *address = ::mmap(nullptr, n_records * sizeof(Record), PROT_READ, MAP_SHARED, fd, 0);
+                    if (address == MAP_FAILED) fail(fd, "mmap");
+                    ::madvise(address, n_records * sizeof(Record), MADV_RANDOM); // 查询是随机的二分查找
+                    records = static_cast<const Record *>(address);
+                }
+                ::close(fd); // 映射建立以后就不再需要文件描述符
+            }
+
+            // 构造失败: 析构函数不会执行, 这里关闭文件并删除, 然后抛出异常
+            [[noreturn]] void fail(int fd, const char *operation) {
+                int error = errno;
+                if (fd >= 0) ::close(fd);
+                ::unlink(path.c_str());
+                errno = error;
+                throw_io_error(operation, path);
+            }
+
+            Run(const Run &) = delete;
+
+            Run &operator=(const Run &) = delete;
+
+            Run(Run &&other) noexcept: path(std::move(other.path)), records(other.records),
+                                       n_records(other.n_records) {
+                other.path.clear();
+                other.records = nullptr;
+                other.n_records = 0;
+            }
+
+            ~Run() {
+                if (records != nullptr) ::munmap(const_cast<Record *>(records), n_records * sizeof(Record));
+                if (!path.empty()) ::unlink(path.c_str());
+            }
+
+            [[nodiscard]] const Record *begin() const { return records; }
+
+            [[nodiscard]] const Record *end() const { return records + n_records; }
+
+            [[nodiscard]] size_t size() const { return n_records; }
+        };
+
+        // 带缓冲的顺序写 run 文件. 没有 finish() 就析构 (比如写入失败抛出异常) 时删除写了一半的文件.
+        class RunWriter {
+        private:
+            std::string path;
+            int fd;
+            std::vector<Record> buffer;
+            static constexpr size_t buffer_records = 1u << 16u;
+
+        public:
+            explicit RunWriter(std::string run_path) : path(std::move(run_path)) {
+                fd = ::open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+                if (fd < 0) throw_io_error("create", path);
+                buffer.reserve(buffer_records);
+            }
+
+            RunWriter(const RunWriter &) = delete;
+
+            RunWriter &operator=(const RunWriter &) = delete;
+
+            ~RunWriter() {
+                if (fd >= 0) {
+                    ::close(fd);
+                    ::unlink(path.c_str());
+                }
+            }
+
+            void append(const Record &record) {
+                buffer.push_back(record);
+                if (buffer.size() == buffer_records) flush();
+            }
+
+            void flush() {
+                const auto *p = reinterpret_cast<const char *>(buffer.data());
+                size_t n = buffer.size() * sizeof(Record);
+                while (n > 0) {
+                    ssize_t ret = ::write(fd, p, n);
+                    if (ret < 0 && errno == EINTR) continue;
+                    if (ret <= 0) throw_io_error("write", path);
+                    p += ret;
+                    n -= static_cast<size_t>(ret);
+                }
+                buffer.clear();
+            }
+
+            Run finish() {
+                flush();
+                int ret = ::close(fd);
+                fd = -1;
+                if (ret < 0) {
+                    int error = errno;
+                    ::unlink(path.c_str());
+                    errno = error;
+                    throw_io_error("close", path);
+                }
+                return Run(path);
+            }
+        };
+
+        struct BandPartition {
+            HashMap<BandHashKeyType, std::vector<MinHashLabel>> memory;
+            size_t memory_records = 0;
+            std::vector<Run> runs;
+            std::vector<size_t> levels; // levels[i] 是 runs[i] 所在的层, 从前往后单调不增
+        };
+
+        std::pair<size_t, size_t> params = {0, 0}; // { b, r }
+        std::vector<BandPartition> bands;
+        std::vector<std::pair<size_t, size_t>> band_hash_range;
+        BandHashFunc bandHashFunc;
+
+        std::filesystem::path directory;
+        size_t max_memory_records;
+        size_t merge_fan_in;
+        size_t memory_records = 0;
+        size_t written_records = 0; // 写到磁盘的记录总数, 包括归并时重写的记录
+        size_t run_counter = 0;
+        std::string run_prefix; // "lsh_<pid>_<instance>_", 同一个目录中每个索引的 run 文件互不冲突
+
+        static size_t next_instance_id() {
+            static std::atomic<size_t> instance_counter{0};
+            return instance_counter.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        std::string next_run_path(size_t band) {
+            return (directory / (run_prefix + "band_" + std::to_string(band) + "_run_" +
+                                 std::to_string(run_counter++) + ".run")).string();
+        }
+
+        // 把某个 band 的内存部分排序后写成一个新的 run
+        void spill(size_t band) {
+            auto &partition = bands[band];
+            if (partition.memory_records == 0) return;
+            std::vector<Record> records;
+            records.reserve(partition.memory_records);
+            for (const auto &[key, labels] : partition.memory) {
+                for (const auto &label : labels) records.push_back({key, label});
+            }
+            std::sort(records.begin(), records.end(), [](const Record &x, const Record &y) { return x.key < y.key; });
+            RunWriter writer(next_run_path(band));
+            for (const auto &record : records) writer.append(record);
+            partition.runs.push_back(writer.finish());
+            partition.levels.push_back(0);
+            written_records += records.size();
+            memory_records -= partition.memory_records;
+            partition.memory_records = 0;
+            HashMap<BandHashKeyType, std::vector<MinHashLabel>>().swap(partition.memory); // 真正释放内存
+            compact(band);
+        }
+
+        // 末尾 merge_fan_in 个 run 在同一层时把它们归并成上一层的一个 run, 直到不再进位.
+        // levels 单调不增, 所以同一层的 run 总是连续地排在末尾.
+        void compact(size_t band) {
+            auto &partition = bands[band];
+            while (partition.runs.size() >= merge_fan_in) {
+                size_t first = partition.runs.size() - merge_fan_in;
+                size_t level = partition.levels.back();
+                if (partition.levels[first] != level) break;
+                merge_runs(band, first);
+                partition.levels.resize(first);
+                partition.levels.push_back(level + 1);
+            }
+        }
+
+        // 多路归并某个 band 从 first 开始的所有 run. 只顺序读取各个 run, 内存开销只有归并堆和写缓冲.
+        // 写入失败时抛出异常, 原来的 run 保持不变.
+        void merge_runs(size_t band, size_t first) {
+            auto &runs = bands[band].runs;
+            using Cursor = std::pair<const Record *, const Record *>; // { current, end }
+            auto greater = [](const Cursor &x, const Cursor &y) { return x.first->key > y.first->key; };
+            std::priority_queue<Cursor, std::vector<Cursor>, decltype(greater)> heap(greater);
+            size_t n_records = 0;
+            for (size_t i = first; i < runs.size(); i++) {
+                if (runs[i].size() > 0) heap.push({runs[i].begin(), runs[i].end()});
+                n_records += runs[i].size();
+            }
+            RunWriter writer(next_run_path(band));
+            while (!heap.empty()) {
+                auto cursor = heap.top();
+                heap.pop();
+                writer.append(*cursor.first);
+                if (++cursor.first != cursor.second) heap.push(cursor);
+            }
+            Run merged = writer.finish();
+            written_records += n_records;
+            while (runs.size() > first) runs.pop_back(); // 旧 run 析构时自动删除文件
+            runs.push_back(std::move(merged));
+        }
+
+        template<typename HashFunc, size_t MinHashBits, size_t Seed, typename RandomGenerator>
+        void query_band(const MinHash <HashFunc, MinHashBits, n_permutation, Seed, RandomGenerator> &min_hash,
+                        size_t band, HashSet <MinHashLabel> &candidate_set) const {
+            const auto &partition = bands[band];
+            auto key = bandHashFunc(min_hash.hash_values, band_hash_range[band]);
+            if (auto pos = partition.memory.find(key); pos != partition.memory.end()) {
+                for (const auto &label : (*pos).second) candidate_set.insert(label);
+            }
+            for (const auto &run : partition.runs) {
+                auto first = std::lower_bound(run.begin(), run.end(), key,
+                                              [](const Record &record, BandHashKeyType k) { return record.key < k; });
+                for (; first != run.end() && first->key == key; ++first) candidate_set.insert(first->label);
+            }
+        }
+
+    public:
+        /**
+         * @param directory run 文件所在目录(不存在时自动创建, 失败时抛出 std::filesystem::filesystem_error)
+         * @param max_memory_records 所有 band 内存部分的 (key,label) 记录总数上限
+         * @param merge_fan_in 同一层攒够多少个 run 时归并 (至少为 2)
+         * 其他参数与 LSH 相同.
+         */
+        explicit ExternalLSH(const std::string &directory,
+                             size_t max_memory_records = 1u << 24u,
+                             size_t merge_fan_in = 8,
+                             double threshold = 0.9,
+                             std::pair<false_positive_weight, false_negative_weight> weights = {0.5, 0.5})
+                : directory(directory), max_memory_records(max_memory_records),
+                  merge_fan_in(std::max<size_t>(merge_fan_in, 2)),
+                  run_prefix("lsh_" + std::to_string(::getpid()) + "_" + std::to_string(next_instance_id()) + "_") {
+            static_assert(n_permutation <= max_n_permutation);
+            assert(threshold >= 0 && threshold <= 1.0);
+            std::filesystem::create_directories(this->directory);
+            if constexpr (b > 0 && r > 0) {
+                static_assert(b * r <= n_permutation);
+                params = {b, r};
+            } else {
+                params = lsh_optimal_params(n_permutation, threshold, weights);
+            }
+            bands.resize(params.first);
+            for (size_t i = 0; i < params.first; i++) {
+                band_hash_range.push_back({i * params.second, (i + 1) * params.second});
+            }
+        }
+
+        ExternalLSH(const ExternalLSH &) = delete;
+
+        ExternalLSH &operator=(const ExternalLSH &) = delete;
+
+        template<typename HashFunc, size_t MinHashBits, size_t Seed, typename RandomGenerator>
+        void insert(const MinHash <HashFunc, MinHashBits, n_permutation, Seed, RandomGenerator> &min_hash,
+                    const MinHashLabel &label) {
+            for (size_t i = 0; i < bands.size(); i++) {
+                auto key = bandHashFunc(min_hash.hash_values, band_hash_range[i]);
+                bands[i].memory[key].push_back(label);
+                bands[i].memory_records++;
+            }
+            memory_records += bands.size();
+            while (memory_records > max_memory_records) {
+                // 溢写内存记录最多的 band, 一次释放尽可能多的内存
+                auto largest = std::max_element(bands.begin(), bands.end(), [](const auto &x, const auto &y) {
+                    return x.memory_records < y.memory_records;
+                });
+                spill(static_cast<size_t>(largest - bands.begin()));
+            }
+        }
+
+        template<typename HashFunc, size_t MinHashBits, size_t Seed, typename RandomGenerator>
+        HashSet <MinHashLabel>
+        query(const MinHash <HashFunc, MinHashBits, n_permutation, Seed, RandomGenerator> &min_hash) const {
+            HashSet<MinHashLabel> candidate_set;
+            for (size_t i = 0; i < bands.size(); i++) query_band(min_hash, i, candidate_set);
+            return candidate_set;
+        }
+
+        // 把所有 band 的内存部分都写到磁盘, 比如建完索引以后释放内存只保留磁盘数据. I/O 出错时抛出 std::system_error
+        void flush() {
+            for (size_t i = 0; i < bands.size(); i++) spill(i);
+        }
+
+        [[nodiscard]] size_t memory_record_size() const { return memory_records; }
+
+        [[nodiscard]] size_t disk_record_size() const {
+            size_t n = 0;
+            for (const auto &band : bands) {
+                for (const auto &run : band.runs) n += run.size();
+            }
+            return n;
+        }
+
+        // 写放大 = 写到磁盘的记录总数 / 磁盘上的记录数
+        [[nodiscard]] double write_amplification() const {
+            size_t n = disk_record_size();
+            return n == 0 ? 0.0 : (double) written_records / (double) n;
+        }
+
+        [[nodiscard]] size_t run_size() const {
+            size_t n = 0;
+            for (const auto &band : bands) n += band.runs.size();
+            return n;
+        }
+
+        void print_config() const {
+            std::cout << "===============  External LSH config  ===============\n";
+            std::cout << "params : b = " << params.first << "  r = " << params.second << "\n";
+            std::cout << "memory records : " << memory_records << " / " << max_memory_records
+                      << "  disk records : " << disk_record_size()
+                      << "  runs : " << run_size()
+                      << "  write amplification : " << write_amplification() << "\n";
+        }
+    };
+}
+#endif //LSH_CPP_LSH_EXTERNAL_H
@@ -0,0 +1,202 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_LSH_HANDLE_H
+#define LSH_CPP_LSH_HANDLE_H
+
+#include "lsh_cpp.h"
+#include "lsh.h"
+
+namespace LSH_CPP {
+    /**
+     * LSH 索引的热替换句柄 (RCU 风格).
+     * 读线程通过 Reader::acquire() 拿到当前索引的只读快照(Snapshot),查询过程完全不加锁;
+     * 新索引在后台构建好以后通过 publish() 原子替换,旧索引等所有读线程离开后再回收,服务不需要重启.
+     *
+     * 回收使用 epoch-based reclamation:
+     * 1. 读线程进入时把当前的 global_epoch 写入自己的 slot,离开时把 slot 置为 inactive_epoch;
+     * 2. publish() 先原子交换索引指针,再把 global_epoch 加一,旧索引记为在 epoch = e 时退休;
+     * 3. 所有 slot 都是 inactive 或者 slot.epoch > e 时,旧索引就不可能再被任何读线程持有,可以安全析构.
+     *    (slot.epoch > e 说明这个读线程是在指针交换之后才读到 global_epoch 的,它拿到的一定是新指针)
+     * 读路径只有两次原子写和一次原子读,不会和写线程竞争锁,所以替换索引时查询延迟保持平稳.
+     *
+     * use case:
+     * LSHHandle<LSH_Type> handle(std::make_unique<LSH_Type>(threshold));
+     * // 读线程(每个线程注册一次 reader,之后反复使用)
+     * auto reader = handle.register_reader();
+     * { auto snapshot = reader.acquire(); auto ret = snapshot->query(min_hash); }
+     * // 写线程
+     * auto future = handle.rebuild_async([&]() { auto lsh = std::make_unique<LSH_Type>(threshold); ...; return lsh; });
+     *
+     * @tparam LSHType 被管理的索引类型,要求 query() 是 const 接口(快照只读).
+     * @tparam max_readers 同时注册的读线程数量上限.
+     */
+    template<typename LSHType, size_t max_readers = 64>
+    class LSHHandle {
+    private:
+        static constexpr uint64_t inactive_epoch = std::numeric_limits<uint64_t>::max();
+
+        // 每个读线程独占一个 slot, 按 cache line 对齐避免 false sharing.
+        struct alignas(64) ReaderSlot {
+            std::atomic<uint64_t> epoch{inactive_epoch};
+            std::atomic<bool> in_use{false};
+        };
+
+        std::atomic<LSHType *> current;
+        std::atomic<uint64_t> global_epoch{0};
+        std::array<ReaderSlot, max_readers> slots;
+
+        // 写线程的状态 (publish 很少发生,直接用互斥锁串行化)
+        std::mutex writer_mutex;
+        std::vector<std::pair<std::unique_ptr<LSHType>, uint64_t>> retired; // { 旧索引, 退休时的 epoch }
+
+        // 调用前必须持有 writer_mutex
+        size_t reclaim_locked() {
+            uint64_t min_active_epoch = inactive_epoch;
+            for (const auto &slot : slots) {
+                min_active_epoch = std::min(min_active_epoch, slot.epoch.load(std::memory_order_seq_cst));
+            }
+            size_t before = retired.size();
+            retired.erase(std::remove_if(retired.begin(), retired.end(),
+                                         [&](const auto &item) { return item.second < min_active_epoch; }),
+                          retired.end());
+            return before - retired.size();
+        }
+
+    public:
+        /**
+         * 只读快照, 析构时离开临界区. 快照存活期间它指向的索引不会被回收.
+         */
+        class Snapshot {
+        private:
+            ReaderSlot *slot;
+            const LSHType *lsh;
+
+        public:
+            Snapshot(ReaderSlot *slot, const LSHType *lsh) : slot(slot), lsh(lsh) {}
+
+            Snapshot(const Snapshot &) = delete;
+
+            Snapshot &operator=(const Snapshot &) = delete;
+
+            Snapshot(Snapshot &&other) noexcept : slot(other.slot), lsh(other.lsh) {
+                other.slot = nullptr;
+                other.lsh = nullptr;
+            }
+
+            ~Snapshot() {
+                if (slot != nullptr) slot->epoch.store(inactive_epoch, std::memory_order_release);
+            }
+
+            const LSHType *operator->() const { return lsh; }
+
+            const LSHType &operator*() const { return *lsh; }
+        };
+
+        /**
+         * 读线程的注册凭证, 持有一个 slot. 同一个 Reader 同一时间只能持有一个 Snapshot (不支持嵌套 acquire).
+         */
+        class Reader {
+        private:
+            LSHHandle *handle;
+            ReaderSlot *slot;
+
+        public:
+            Reader(LSHHandle *handle, ReaderSlot *slot) : handle(handle), slot(slot) {}
+
+            Reader(const Reader &) = delete;
+
+            Reader &operator=(const Reader &) = delete;
+
+            Reader(Reader &&other) noexcept : handle(other.handle), slot(other.slot) {
+                other.handle = nullptr;
+                other.slot = nullptr;
+            }
+
+            ~Reader() {
+                if (slot != nullptr) slot->in_use.store(false, std::memory_order_release);
+            }
+
+            Snapshot acquire() {
+                assert(slot->epoch.load(std::memory_order_relaxed) == inactive_epoch);
+                slot->epoch.store(handle->global_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+                return Snapshot(slot, handle->current.load(std::memory_order_seq_cst));
+            }
+        };
+
+        explicit LSHHandle(std::unique_ptr<LSHType> lsh) : current(lsh.release()) {
+            assert(current.load() != nullptr);
+        }
+
+        LSHHandle(const LSHHandle &) = delete;
+
+        LSHHandle &operator=(const LSHHandle &) = delete;
+
+        // 析构时要求所有 Reader 已经释放.
+        ~LSHHandle() {
+            delete current.load();
+        }
+
+        /**
+         * 注册读线程. slot 全部被占用时返回空值.
+         */
+        std::optional<Reader> register_reader() {
+            for (auto &slot : slots) {
+                bool expected = false;
+                if (slot.in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                    return std::optional<Reader>(std::in_place, this, &slot);
+                }
+            }
+            return std::nullopt;
+        }
+
+        /**
+         * 原子发布新索引. 旧索引进入退休列表,并顺带回收已经没有读线程持有的退休索引.
+         */
+        void publish(std::unique_ptr<LSHType> lsh) {
+            assert(lsh != nullptr);
+            std::lock_guard<std::mutex> lock(writer_mutex);
+            LSHType *old = current.exchange(lsh.release(), std::memory_order_seq_cst);
+            uint64_t retire_epoch = global_epoch.fetch_add(1, std::memory_order_seq_cst);
+            retired.emplace_back(std::unique_ptr<LSHType>(old), retire_epoch);
+            reclaim_locked();
+        }
+
+        /**
+         * 在后台线程调用 builder() 构建新索引, 构建完成后立即 publish.
+         * @tparam Builder 返回 std::unique_ptr<LSHType> 的可调用对象
+         */
+        template<typename Builder>
+        std::future<void> rebuild_async(Builder &&builder) {
+            return std::async(std::launch::async, [this, builder = std::forward<Builder>(builder)]() mutable {
+                publish(builder());
+            });
+        }
+
+        // 尝试回收退休索引,返回本次回收的个数
+        size_t reclaim() {
+            std::lock_guard<std::mutex> lock(writer_mutex);
+            return reclaim_locked();
+        }
+
+        // 等待所有退休索引被回收 (即等待持有旧快照的读线程全部离开)
+        void synchronize() {
+            while (retired_size() > 0) {
+                reclaim();
+                std::this_thread::yield();
+            }
+        }
+
+        size_t retired_size() {
+            std::lock_guard<std::mutex> lock(writer_mutex);
+            return retired.size();
+        }
+
+        // 已经发布过的次数
+        [[nodiscard]] uint64_t version() const {
+            return global_epoch.load(std::memory_order_acquire);
+        }
+    };
+}
+#endif //LSH_CPP_LSH_HANDLE_H
@@ -0,0 +1,354 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_LSH_SHARDED_H
+#define LSH_CPP_LSH_SHARDED_H
+
+#include "lsh_cpp.h"
+#include "util.h"
+#include "hash.h"
+#include "minhash.h"
+#include "lsh.h"
+
+namespace LSH_CPP {
+    namespace detail {
+        // 读满/写满 n 个字节, 对端关闭或出错时返回 false
+        inline bool shard_read_full(int fd, void *buffer, size_t n) {
+            auto *p = static_cast<char *>(buffer);
+            while (n > 0) {
+                ssize_t ret = ::read(fd, p, n);
+                if (ret < 0 && errno == EINTR) continue;
+                if (ret <= 0) return false;
+                p += ret;
+                n -= static_cast<size_t>(ret);
+            }
+            return true;
+        }
+
+        inline bool shard_write_full(int fd, const void *buffer, size_t n) {
+            const auto *p = static_cast<const char *>(buffer);
+            while (n > 0) {
+                ssize_t ret = ::send(fd, p, n, MSG_NOSIGNAL);
+                if (ret < 0 && errno == EINTR) continue;
+                if (ret <= 0) return false;
+                p += ret;
+                n -= static_cast<size_t>(ret);
+            }
+            return true;
+        }
+    }
+
+    /**
+     * 按 band 分片的多进程 LSH. 接口和 LSH 一致 (insert / query), 索引数据分布在 n_shards 个本地 worker 进程中.
+     *
+     * 分片方式: 第 i 个 band 属于第 i % n_shards 个 worker, 每个 worker 只保存自己那几个 band 的哈希表,
+     * 所以单个 worker 的内存大约是单进程 LSH 的 1 / n_shards.
+     * coordinator (当前进程) 负责计算 band key (只是对 r 个最小哈希值做一次哈希, 很便宜), 然后:
+     *   insert: 按 worker 缓冲 (band, key, label) 记录, 攒够 batch_size 条再一次性发送;
+     *   query : 先把所有 worker 的请求都发出去, 再依次读取结果并合并 candidate set, 各个 worker 并行查找.
+     * coordinator 和 worker 之间是 socketpair(AF_UNIX) 上的二进制消息 (同一台机器, 直接使用主机字节序):
+     *   Insert : uint8 op | uint32 n | n * InsertRecord
+     *   Query  : uint8 op | uint32 n_queries | n_queries * n_owned_bands * uint64 key   (band 顺序固定)
+     *            -> n_queries * uint32 n_labels | 所有 label                            (每个 query 在 worker 内已去重)
+     *   Stats  : uint8 op -> ShardStats
+     *   Exit   : uint8 op
+     * 换成 TCP socket 就可以把 worker 放到其他机器上, 消息格式不需要变化.
+     *
+     * 构造时 fork worker 进程. 子进程只执行 worker_loop, 其中只用到 read / send / close 和内存分配 (glibc 在 fork 时会
+     * 重置 malloc 的锁), 不使用 iostream, OpenMP 或者其他线程可能持有的锁, 所以可以在已经启动了其他线程的程序中创建.
+     * 出错时 (socketpair / fork 失败, worker 退出, 发送失败) 抛出异常: 构造函数抛出 std::system_error, 并且已经创建的
+     * worker 会被回收; insert / query / stats 抛出 std::system_error 或 std::runtime_error, 之后和 worker 之间的消息
+     * 可能已经不同步, 这个 ShardedLSH 只能析构.
+     * @tparam MinHashLabel 必须是 trivially copyable 的类型 (一般是整数编号), 因为直接按二进制发送.
+     */
+    template<
+            typename BandHashFunc = XXUInt64Hash64,
+            typename MinHashLabel = size_t,
+            size_t b = 0,
+            size_t r = 0,
+            size_t n_permutation = 128
+    >
+    class ShardedLSH {
+        static_assert(std::is_trivially_copyable_v<MinHashLabel>,
+                      "ShardedLSH only supports trivially copyable label.");
+    public:
+        using BandHashKeyType = uint64_t;
+        using false_positive_weight = double;
+        using false_negative_weight = double;
+
+        struct ShardStats {
+            uint64_t n_bands;
+            uint64_t n_keys;
+            uint64_t n_records;
+        };
+
+    private:
+        enum class Op : uint8_t {
+            Exit = 0,
+            Insert = 1,
+            Query = 2,
+            Stats = 3,
+        };
+
+        struct InsertRecord {
+            BandHashKeyType key;
+            uint32_t band; // worker 内部的 band 下标
+            MinHashLabel label;
+        };
+
+        struct Shard {
+            pid_t pid = -1;
+            int fd = -1;
+            std::vector<InsertRecord> insert_buffer;
+        };
+
+        std::pair<size_t, size_t> params = {0, 0}; // { b, r }
+        std::vector<std::pair<size_t, size_t>> band_hash_range;
+        BandHashFunc bandHashFunc;
+        std::vector<Shard> shards;
+        size_t batch_size;
+
+        static void send_or_throw(int fd, const void *buffer, size_t n) {
+            if (!detail::shard_write_full(fd, buffer, n)) {
+                throw std::system_error(errno, std::generic_category(), "ShardedLSH: send to worker fail");
+            }
+        }
+
+        static void receive_or_throw(int fd, void *buffer, size_t n) {
+            if (!detail::shard_read_full(fd, buffer, n)) {
+                throw std::runtime_error("ShardedLSH: worker closed connection");
+            }
+        }
+
+        // 通知所有 worker 退出并回收进程
+        void shutdown() {
+            for (auto &shard : shards) {
+                auto op = Op::Exit;
+                detail::shard_write_full(shard.fd, &op, sizeof(op));
+                ::close(shard.fd);
+            }
+            for (auto &shard : shards) ::waitpid(shard.pid, nullptr, 0);
+            shards.clear();
+        }
+
+        // worker 进程的主循环, 只持有自己的 band 哈希表, 处理 coordinator 的消息直到 Exit
+        static void worker_loop(int fd, size_t n_bands) {
+            std::vector<HashMap<BandHashKeyType, std::vector<MinHashLabel>>> band_hash_maps(n_bands);
+            std::vector<InsertRecord> records;
+            std::vector<BandHashKeyType> keys;
+            std::vector<uint32_t> counts;
+            std::vector<MinHashLabel> labels;
+            HashSet<MinHashLabel> candidate_set;
+            Op op;
+            while (detail::shard_read_full(fd, &op, sizeof(op))) {
+                if (op == Op::Exit) break;
+                if (op == Op::Stats) {
+                    ShardStats stats{n_bands, 0, 0};
+                    for (const auto &band_hash_map : band_hash_maps) {
+                        stats.n_keys += band_hash_map.size();
+                        for (const auto &item : band_hash_map) stats.n_records += item.second.size();
+                    }
+                    if (!detail::shard_write_full(fd, &stats, sizeof(stats))) break;
+                    continue;
+                }
+                uint32_t n;
+                if (!detail::shard_read_full(fd, &n, sizeof(n))) break;
+                if (op == Op::Insert) {
+                    records.resize(n);
+                    if (!detail::shard_read_full(fd, records.data(), n * sizeof(InsertRecord))) break;
+                    for (const auto &record : records) {
+                        band_hash_maps[record.band][record.key].push_back(record.label);
+                    }
+                } else if (op == Op::Query) {
+                    keys.resize(static_cast<size_t>(n) * n_bands);
+                    if (!detail::shard_read_full(fd, keys.data(), keys.size() * sizeof(BandHashKeyType))) break;
+                    counts.resize(n);
+                    labels.clear();
+                    for (size_t q = 0; q < n; q++) {
+                        candidate_set.clear();
+                        for (size_t i = 0; i < n_bands; i++) {
+                            const auto &band_hash_map = band_hash_maps[i];
+                            if (auto pos = band_hash_map.find(keys[q * n_bands + i]); pos != band_hash_map.end()) {
+                                for (const auto &label : (*pos).second) candidate_set.insert(label);
+                            }
+                        }
+                        counts[q] = static_cast<uint32_t>(candidate_set.size());
+                        labels.insert(labels.end(), candidate_set.begin(), candidate_set.end());
+                    }
+                    if (!detail::shard_write_full(fd, counts.data(), counts.size() * sizeof(uint32_t)) ||
+                        !detail::shard_write_full(fd, labels.data(), labels.size() * sizeof(MinHashLabel)))
+                        break;
+                } else {
+                    break;
+                }
+            }
+            ::close(fd);
+        }
+
+        void flush_shard(size_t shard) {
+            auto &buffer = shards[shard].insert_buffer;
+            if (buffer.empty()) return;
+            auto op = Op::Insert;
+            auto n = static_cast<uint32_t>(buffer.size());
+            send_or_throw(shards[shard].fd, &op, sizeof(op));
+            send_or_throw(shards[shard].fd, &n, sizeof(n));
+            send_or_throw(shards[shard].fd, buffer.data(), buffer.size() * sizeof(InsertRecord));
+            buffer.clear();
+        }
+
+    public:
+        /**
+         * @param n_shards worker 进程个数 (超过 band 个数时按 band 个数创建)
+         * @param batch_size 每个 worker 的插入缓冲条数
+         * 其他参数与 LSH 相同.
+         */
+        explicit ShardedLSH(size_t n_shards,
+                            double threshold = 0.9,
+                            std::pair<false_positive_weight, false_negative_weight> weights = {0.5, 0.5},
+                            size_t batch_size = 4096) : batch_size(std::max<size_t>(batch_size, 1)) {
+            static_assert(n_permutation <= max_n_permutation);
+            assert(threshold >= 0 && threshold <= 1.0);
+            assert(n_shards > 0);
+            if constexpr (b > 0 && r > 0) {
+                static_assert(b * r <= n_permutation);
+                params = {b, r};
+            } else {
+                params = lsh_optimal_params(n_permutation, threshold, weights);
+            }
+            for (size_t i = 0; i < params.first; i++) {
+                band_hash_range.push_back({i * params.second, (i + 1) * params.second});
+            }
+            const size_t n_workers = std::min(n_shards, params.first);
+            shards.reserve(n_workers);
+            std::cout.flush(); // 避免 fork 以后子进程重复输出父进程缓冲区里的内容
+            for (size_t s = 0; s < n_workers; s++) {
+                int fds[2];
+                if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+                    int error = errno;
+                    shutdown();
+                    throw std::system_error(error, std::generic_category(), "ShardedLSH: socketpair fail");
+                }
+                // 第 s 个 worker 持有 band s, s + n_workers, s + 2 * n_workers ...
+                const size_t n_owned_bands = (params.first - s + n_workers - 1) / n_workers;
+                pid_t pid = ::fork();
+                if (pid < 0) {
+                    int error = errno;
+                    ::close(fds[0]);
+                    ::close(fds[1]);
+                    shutdown();
+                    throw std::system_error(error, std::generic_category(), "ShardedLSH: fork fail");
+                }
+                if (pid == 0) {
+                    ::close(fds[0]);
+                    for (const auto &shard : shards) ::close(shard.fd); // 其他 worker 的连接只属于 coordinator
+                    // 子进程不能让异常 (比如 HashMap 扩容时的 std::bad_alloc) 穿过 fork 回到父进程的调用栈,
+                    // 否则会在子进程里继续运行一份调用方的程序. 异常退出时 coordinator 会收到连接关闭的错误.
+                    try {
+                        worker_loop(fds[1], n_owned_bands);
+                    } catch (...) {
+                        ::_exit(1);
+                    }
+                    ::_exit(0);
+                }
+                ::close(fds[1]);
+                Shard shard;
+                shard.pid = pid;
+                shard.fd = fds[0];
+                shard.insert_buffer.reserve(this->batch_size);
+                shards.push_back(std::move(shard));
+            }
+        }
+
+        ShardedLSH(const ShardedLSH &) = delete;
+
+        ShardedLSH &operator=(const ShardedLSH &) = delete;
+
+        ~ShardedLSH() { shutdown(); }
+
+        template<typename HashFunc, size_t MinHashBits, size_t Seed, typename RandomGenerator>
+        void insert(const MinHash <HashFunc, MinHashBits, n_permutation, Seed, RandomGenerator> &min_hash,
+                    const MinHashLabel &label) {
+            for (size_t i = 0; i < band_hash_range.size(); i++) {
+                size_t shard = i % shards.size();
+                auto key = bandHashFunc(min_hash.hash_values, band_hash_range[i]);
+                shards[shard].insert_buffer.push_back({key, static_cast<uint32_t>(i / shards.size()), label});
+                if (shards[shard].insert_buffer.size() >= batch_size) flush_shard(shard);
+            }
+        }
+
+        // 把所有缓冲的插入记录发送给 worker. query 之前会自动调用.
+        void flush() {
+            for (size_t s = 0; s < shards.size(); s++) flush_shard(s);
+        }
+
+        /**
+         * 批量查询: 一次消息往返完成所有 query, 适合高吞吐场景.
+         */
+        template<typename HashFunc, size_t MinHashBits, size_t Seed, typename RandomGenerator>
+        std::vector<HashSet<MinHashLabel>>
+        query(const std::vector<MinHash<HashFunc, MinHashBits, n_permutation, Seed, RandomGenerator>> &min_hashes) {
+            flush();
+            const auto n_queries = static_cast<uint32_t>(min_hashes.size());
+            std::vector<BandHashKeyType> keys;
+            for (size_t s = 0; s < shards.size(); s++) {
+                keys.clear();
+                for (const auto &min_hash : min_hashes) {
+                    for (size_t i = s; i < band_hash_range.size(); i += shards.size()) {
+                        keys.push_back(bandHashFunc(min_hash.hash_values, band_hash_range[i]));
+                    }
+                }
+                auto op = Op::Query;
+                send_or_throw(shards[s].fd, &op, sizeof(op));
+                send_or_throw(shards[s].fd, &n_queries, sizeof(n_queries));
+                send_or_throw(shards[s].fd, keys.data(), keys.size() * sizeof(BandHashKeyType));
+            }
+            std::vector<HashSet<MinHashLabel>> candidate_sets(min_hashes.size());
+            std::vector<uint32_t> counts(n_queries);
+            std::vector<MinHashLabel> labels;
+            for (auto &shard : shards) {
+                receive_or_throw(shard.fd, counts.data(), counts.size() * sizeof(uint32_t));
+                labels.resize(std::accumulate(counts.begin(), counts.end(), size_t(0)));
+                receive_or_throw(shard.fd, labels.data(), labels.size() * sizeof(MinHashLabel));
+                auto it = labels.begin();
+                for (size_t q = 0; q < n_queries; q++) {
+                    candidate_sets[q].insert(it, it + counts[q]);
+                    it += counts[q];
+                }
+            }
+            return candidate_sets;
+        }
+
+        template<typename HashFunc, size_t MinHashBits, size_t Seed, typename RandomGenerator>
+        HashSet <MinHashLabel>
+        query(const MinHash <HashFunc, MinHashBits, n_permutation, Seed, RandomGenerator> &min_hash) {
+            return std::move(query(std::vector{min_hash}).front());
+        }
+
+        [[nodiscard]] size_t shard_size() const { return shards.size(); }
+
+        // 每个 worker 持有的 band / key / label 记录数
+        std::vector<ShardStats> stats() {
+            flush();
+            std::vector<ShardStats> ret(shards.size());
+            for (auto &shard : shards) {
+                auto op = Op::Stats;
+                send_or_throw(shard.fd, &op, sizeof(op));
+            }
+            for (size_t s = 0; s < shards.size(); s++) receive_or_throw(shards[s].fd, &ret[s], sizeof(ShardStats));
+            return ret;
+        }
+
+        void print_config() {
+            std::cout << "===============  Sharded LSH config  ===============\n";
+            std::cout << "params : b = " << params.first << "  r = " << params.second
+                      << "  shards : " << shards.size() << "\n";
+            auto all_stats = stats();
+            for (size_t s = 0; s < all_stats.size(); s++) {
+                std::cout << "shard " << s << " : bands = " << all_stats[s].n_bands << "  keys = "
+                          << all_stats[s].n_keys << "  records = " << all_stats[s].n_records << "\n";
+            }
+        }
+    };
+}
+#endif //LSH_CPP_LSH_SHARDED_H
@@ -10,6 +10,7 @@
 #include "io.h"
 #include "hash.h"
 #include "lru_cache.h"
+#include "hyperloglog.h"
 
 namespace LSH_CPP {
     constexpr static size_t max_n_permutation = 1024;  // permutation 最大数量.
@@ -99,9 +100,11 @@ namespace LSH_CPP {
         using MapArray = Eigen::Map<Array>;
 
         // 对Eigen的对齐问题,见:https://eigen.tuxfamily.org/dox/group__TopicStlContainers.html
-        using Cache = lru_cache<uint64_t, Array, phmap::Hash<uint64_t>, phmap::EqualTo<uint64_t>,
+        // 全局 lru_cache 加速 update 计算. 所有线程共享同一个缓存 (分片加锁), 多个线程可以同时对不同的 MinHash
+        // 调用 update (比如 server 里批量并行计算 sketch), 缓存的内存也不会随线程个数成倍增长.
+        using Cache = concurrent_lru_cache<uint64_t, Array, phmap::Hash<uint64_t>, phmap::EqualTo<uint64_t>,
                 Eigen::aligned_allocator, phmap::flat_hash_map>;
-        static Cache cache; // 全局 lru_cache 加速 update 计算.
+        static Cache cache;
 
     public:
         // TODO: 使用std::array<T,N>作为hash_value的类型.但是这个修改需要连带更改hash.h里面的接口.
@@ -168,6 +171,30 @@ namespace LSH_CPP {
             }
         }
 
+        /**
+         * 单个元素在 n_permutation 个随机哈希函数下的哈希值, 写入 output[0, n_permutation).
+         * update(val) 等价于 hash_values[i] = min(hash_values[i], output[i]), 需要自己维护最小值的场景
+         * (比如滑动窗口中元素会过期的 WindowedMinHash) 可以用它取得每个元素的哈希值. 不经过 lru_cache.
+         */
+        template<typename T>
+        void element_hash_values(const T &val, _hash_value_store_type *output) {
+            MapArray output_array(output, n_permutation);
+            MapArray vector_a(permutation.vector_a.data(), n_permutation);
+            MapArray vector_b(permutation.vector_b.data(), n_permutation);
+            auto value = hash_func(val);
+            output_array = (vector_a * value + vector_b).unaryExpr(
+                    [&](const auto x) -> uint64_t { return (x % mersenne_prime) & _max_hash_range; });
+        }
+
+        /**
+         * 合并另一个 MinHash (相同的哈希函数和 permutation), 逐位置取最小值.
+         * 结果等于对两个集合的并集计算的 MinHash, 所以可以把一个大集合分块计算再合并.
+         */
+        void merge(const MinHash &other) {
+            MapArray hash_values_array(hash_values.data(), n_permutation);
+            hash_values_array = hash_values_array.min(Eigen::Map<const Array>(other.hash_values.data(), n_permutation));
+        }
+
         [[nodiscard]]constexpr inline size_t length() const {
             return n_permutation;
         }
@@ -183,6 +210,39 @@ namespace LSH_CPP {
     typename MinHash<HashFunc, MinHashBits, n_permutation, Seed, RandomGenerator>::Cache
             MinHash<HashFunc, MinHashBits, n_permutation, Seed, RandomGenerator>::cache{max_cache_size};
 
+    /**
+     * 分块并行计算一条长 DNA 序列 (比如整个基因组) 的 MinHash, 结果和
+     * MinHashType{}.update(split_dna_shingling<k, WeightFlag::no_weight>(sequence)) 完全相同.
+     * 序列按 k-mer 起始位置切分成大小为 chunk_size 的块, 相邻块重叠 k-1 个碱基, 所以每个 k-mer 至少属于一个块;
+     * 每个线程依次处理若干块并合并到自己的 MinHash 中, 最后合并所有线程的结果.
+     * 同一时刻每个线程只持有一个块的 HashSet, 内存和 chunk_size * n_threads 成正比, 而不是和整条序列的长度成正比.
+     * MinHashType 的哈希函数需要接受 DNA_Shingling<k, WeightFlag::no_weight> (比如 StdDNAShinglingHash64<k>).
+     */
+    template<size_t k, typename MinHashType>
+    MinHashType parallel_dna_minhash(const std::string_view &sequence, size_t chunk_size = size_t(1) << 20u,
+                                     size_t n_threads = CPU_THREAD_NUMBERS) {
+        MinHashType result;
+        if (sequence.size() <= k || chunk_size == 0) {
+            result.update(split_dna_shingling<k, WeightFlag::no_weight>(sequence));
+            return result;
+        }
+        const size_t n_k_mers = sequence.size() - k + 1;
+        const size_t n_chunks = (n_k_mers + chunk_size - 1) / chunk_size;
+#pragma omp parallel num_threads(n_threads)
+        {
+            MinHashType local;
+#pragma omp for schedule(dynamic)
+            for (size_t chunk = 0; chunk < n_chunks; chunk++) {
+                size_t begin = chunk * chunk_size;
+                size_t end = std::min(n_k_mers, begin + chunk_size); // 本块 k-mer 起始位置 [begin, end)
+                local.update(split_dna_shingling<k, WeightFlag::no_weight>(sequence.substr(begin, end - begin + k - 1)));
+            }
+#pragma omp critical
+            result.merge(local);
+        }
+        return result;
+    }
+
     // 下面的 jaccard_similarity 计算公式是通过 min_hash_value_vector 估计得到的,
     // 只是从概率上和真实的jaccard_similarity相等,和真实的jaccard_similarity依然存在偏差.
     template<typename H,
@@ -214,6 +274,68 @@ namespace LSH_CPP {
         return (double) count / (double) (A.size() + B.size() - count);
     }
 
+    // 包含度计算(针对无权重集合): containment(A, B) = |A intersection B| / |A|. 使用HashSet,复杂度O(|A|).
+    template<typename T>
+    double containment(const HashSet<T> &A, const HashSet<T> &B) {
+        if (A.empty()) return 0;
+        size_t count = 0;
+        for (const auto &a:A) { if (B.contains(a)) count++; }
+        return (double) count / (double) A.size();
+    }
+
+    /**
+     * 由 MinHash 估计的 jaccard 相似度 J 和两个集合的大小估计交集大小和包含度:
+     *   J = |A∩B| / (|A| + |B| - |A∩B|)  =>  |A∩B| = J * (|A| + |B|) / (1 + J)
+     *   containment(A, B) = |A∩B| / |A|
+     * 集合大小可以是精确值 (比如建索引时记录的 HashSet::size()), 也可以是 HyperLogLog 的估计值.
+     * 与 jaccard 不同, containment 不受 |B| 远大于 |A| 的影响, 适合 read (A) 对 genome (B) 的筛选.
+     * 注意 |A| 远小于 |B| 时 J 很小, MinHash 对 J 的估计误差会被放大, 这时需要更多的 permutation.
+     */
+    template<typename H, size_t _min_hash_bits, size_t _n_permutation, size_t _Seed, typename _RandomGenerator>
+    double minhash_intersection_size(const MinHash<H, _min_hash_bits, _n_permutation, _Seed, _RandomGenerator> &A,
+                                     const MinHash<H, _min_hash_bits, _n_permutation, _Seed, _RandomGenerator> &B,
+                                     double size_a, double size_b) {
+        size_t count = 0;
+        for (size_t i = 0; i < _n_permutation; i++) count += (A.hash_values[i] == B.hash_values[i]);
+        double jaccard = (double) count / (double) _n_permutation;
+        return std::min({jaccard * (size_a + size_b) / (1 + jaccard), size_a, size_b});
+    }
+
+    template<typename H, size_t _min_hash_bits, size_t _n_permutation, size_t _Seed, typename _RandomGenerator>
+    double minhash_containment(const MinHash<H, _min_hash_bits, _n_permutation, _Seed, _RandomGenerator> &A,
+                               const MinHash<H, _min_hash_bits, _n_permutation, _Seed, _RandomGenerator> &B,
+                               double size_a, double size_b) {
+        if (size_a <= 0) return 0;
+        return minhash_intersection_size(A, B, size_a, size_b) / size_a;
+    }
+
+    // 集合大小由 HyperLogLog 估计
+    template<typename H, size_t _min_hash_bits, size_t _n_permutation, size_t _Seed, typename _RandomGenerator,
+            typename HLLHashFunc, size_t p>
+    double minhash_containment(const MinHash<H, _min_hash_bits, _n_permutation, _Seed, _RandomGenerator> &A,
+                               const MinHash<H, _min_hash_bits, _n_permutation, _Seed, _RandomGenerator> &B,
+                               const HyperLogLog<HLLHashFunc, p> &hll_a, const HyperLogLog<HLLHashFunc, p> &hll_b) {
+        return minhash_containment(A, B, hll_a.cardinality(), hll_b.cardinality());
+    }
+
+    /**
+     * 1-vs-N 批量计算 query 在每个 reference 中的包含度 containment(query, reference_i),
+     * 比如一条 read 对所有 genome 的筛选. reference 之间并行计算.
+     */
+    template<typename H, size_t _min_hash_bits, size_t _n_permutation, size_t _Seed, typename _RandomGenerator>
+    std::vector<double> minhash_containment(
+            const MinHash<H, _min_hash_bits, _n_permutation, _Seed, _RandomGenerator> &query, double query_size,
+            const std::vector<MinHash<H, _min_hash_bits, _n_permutation, _Seed, _RandomGenerator>> &references,
+            const std::vector<double> &reference_sizes) {
+        assert(references.size() == reference_sizes.size());
+        std::vector<double> result(references.size());
+#pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < references.size(); i++) {
+            result[i] = minhash_containment(query, references[i], query_size, reference_sizes[i]);
+        }
+        return result;
+    }
+
     template<typename H,
             size_t _min_hash_bits,
             size_t _n_permutation,
@@ -0,0 +1,265 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_MINIMIZER_H
+#define LSH_CPP_MINIMIZER_H
+
+#include "lsh_cpp.h"
+#include "k_shingles.h"
+
+namespace LSH_CPP {
+    /**
+     * DNA 序列的 (w, k) minimizer.
+     * 参考: Roberts et al., "Reducing storage requirements for biological sequence comparison", Bioinformatics 2004;
+     *       Li, "Minimap2: pairwise alignment for nucleotide sequences", Bioinformatics 2018.
+     *
+     * 每 w 个连续的 k-mer 组成一个窗口, 窗口中哈希值最小的 k-mer 就是这个窗口的 minimizer, 相邻窗口的 minimizer 大部分相同,
+     * 所以一条长度为 N 的 read 平均只有约 2N / (w + 1) 个不同的 minimizer, 并且两条 read 只要有一段长度 >= w + k - 1
+     * 的公共子串, 就一定有相同的 minimizer (和位置), 可以作为 seed-and-extend 的种子.
+     * 对 10-100 kbp 的长 read, 整条 read 一个 MinHash 会丢失局部信息 (只有小部分重叠的 read 相似度很低), 而完整的 k-mer 集合又太大,
+     * minimizer 只保留一小部分 k-mer 和它们的位置.
+     *
+     * 实现: 滚动计算 2-bit 编码 (和 dna_kmer_code_count 相同), 编码经过 2k 位内可逆的整数哈希 (不同 k-mer 哈希值一定不同,
+     * 同时避免字典序最小的 poly-A 之类的 k-mer 总是被选中), 窗口最小值用单调队列维护, 每个 k-mer 均摊 O(1).
+     * canonical = true 时同时滚动计算反向互补链的编码 (互补碱基的编码只差最低位: A=00/T=01, C=10/G=11), 取两者中较小的编码,
+     * 这样 read 和它的反向互补链有相同的 minimizer 集合. 含有非 ACGT 字符时窗口重新开始.
+     */
+    struct Minimizer {
+        uint64_t hash;     // k-mer 编码的哈希值 (2k 位内可逆, 所以也唯一确定了 k-mer)
+        uint32_t position; // k-mer 第一个碱基在 read 中的位置 (从 0 开始)
+        bool reverse;      // canonical 时选中的是反向互补链上的 k-mer
+
+        bool operator==(const Minimizer &other) const {
+            return hash == other.hash && position == other.position && reverse == other.reverse;
+        }
+    };
+
+    namespace detail {
+        // 2k 位内可逆的整数哈希 (Thomas Wang 的 64 位整数哈希, 每一步都在 mask 内进行, 与 minimap2 相同)
+        inline uint64_t kmer_hash64(uint64_t key, uint64_t mask) {
+            key = (~key + (key << 21u)) & mask;
+            key = key ^ key >> 24u;
+            key = ((key + (key << 3u)) + (key << 8u)) & mask;
+            key = key ^ key >> 14u;
+            key = ((key + (key << 2u)) + (key << 4u)) & mask;
+            key = key ^ key >> 28u;
+            key = (key + (key << 31u)) & mask;
+            return key;
+        }
+    }
+
+    /**
+     * 计算 read 的所有 (w, k) minimizer, 按位置递增排序, 连续窗口的相同 minimizer 只输出一次.
+     * 窗口中有多个相同的最小哈希值时选择最左边的 k-mer. 长度小于 w + k - 1 的 (连续 ACGT) 片段没有完整的窗口, 不输出.
+     */
+    template<size_t k, size_t w, bool canonical = false>
+    std::vector<Minimizer> dna_minimizers(const std::string_view &read) {
+        static_assert(k > 0 && k <= 32, "k-mer 2-bit code must fit in uint64_t.");
+        static_assert(w > 0 && w < 256, "minimizer window should be in [1, 255].");
+        constexpr uint64_t mask = (k == 32) ? ~uint64_t(0) : ((uint64_t(1) << (2 * k)) - 1);
+        constexpr uint64_t high_shift = 2 * (k - 1);
+
+        std::vector<Minimizer> result;
+        if (read.size() >= w + k - 1) result.reserve(2 * (read.size() - k + 1) / (w + 1) + 1);
+        // 单调队列: 哈希值不递减 (相同的哈希值保留左边的), 队首就是当前窗口的最小值. 容量为 w 的环形数组, 队列中最多 w 个 k-mer.
+        std::array<std::pair<Minimizer, size_t>, w> queue; // { minimizer, 片段内 k-mer 编号 }
+        size_t head = 0, n_queue = 0;
+        uint64_t forward = 0, backward = 0;
+        size_t valid = 0, n_k_mers = 0;
+        uint32_t last_position = std::numeric_limits<uint32_t>::max();
+        for (size_t i = 0; i < read.size(); i++) {
+            int base = dna_base_code(read[i]);
+            if (base < 0) {
+                valid = n_k_mers = n_queue = 0;
+                continue;
+            }
+            forward = ((forward << 2u) | static_cast<uint64_t>(base)) & mask;
+            if constexpr (canonical) backward = (backward >> 2u) | (static_cast<uint64_t>(base ^ 1) << high_shift);
+            if (++valid < k) continue;
+            bool reverse = canonical && backward < forward;
+            Minimizer current{detail::kmer_hash64(reverse ? backward : forward, mask),
+                              static_cast<uint32_t>(i + 1 - k), reverse};
+            const size_t index = n_k_mers++;
+            if (n_queue > 0 && queue[head].second + w <= index) { // 队首已经不在窗口 [index - w + 1, index] 中
+                head = (head + 1) % w;
+                n_queue--;
+            }
+            while (n_queue > 0 && queue[(head + n_queue - 1) % w].first.hash > current.hash) n_queue--;
+            queue[(head + n_queue++) % w] = {current, index};
+            if (index + 1 >= w && queue[head].first.position != last_position) {
+                result.push_back(queue[head].first);
+                last_position = queue[head].first.position;
+            }
+        }
+        return result;
+    }
+
+    // minimizer 的哈希值集合, 可以直接作为 MinHash<XXUInt64Hash64 ...> / LSH 的输入 (只保留 minimizer 的 k-mer 集合).
+    template<size_t k, size_t w, bool canonical = false>
+    HashSet<uint64_t> dna_minimizer_hash_set(const std::string_view &read) {
+        auto minimizers = dna_minimizers<k, w, canonical>(read);
+        HashSet<uint64_t> result(minimizers.size());
+        for (const auto &minimizer : minimizers) result.insert(minimizer.hash);
+        return result;
+    }
+
+    /**
+     * minimizer -> { read, 位置 } 的倒排索引, 用于长 read 的重叠检测 (seed-and-extend 中的 seed 部分).
+     * build 时提取所有 read 的 minimizer 并按哈希值排序, 查询时对 query 的每个 minimizer 二分查找相同哈希值的区间.
+     * 出现次数超过 max_occurrence 的 minimizer (重复序列) 会被丢弃, 否则它们会产生大量没有意义的命中.
+     * 命中按 { label, 链方向 } 分组以后, 同一次真实重叠的命中位于同一条对角线 (target - query 或 target + query 近似相同),
+     * overlap 只统计最密集的对角线附近的命中, 过滤掉分散在不同位置的偶然命中.
+     *
+     * @tparam Label 必须是 trivially copyable 的类型 (一般是 read 编号)
+     */
+    template<size_t k, size_t w, bool canonical = true, typename Label = uint32_t>
+    class MinimizerIndex {
+        static_assert(std::is_trivially_copyable_v<Label>, "MinimizerIndex only supports trivially copyable label.");
+    public:
+        struct Entry {
+            uint64_t hash;
+            Label label;
+            uint32_t position;
+            bool reverse;
+        };
+
+        struct Hit {
+            Label label;
+            uint32_t query_position;
+            uint32_t target_position;
+            bool same_strand; // canonical 时 query 与 target 的 minimizer 是否在同一条链上
+        };
+
+        struct Overlap {
+            Label label;
+            bool same_strand;
+            size_t n_hits;             // 最密集的对角线附近的命中个数
+            uint32_t query_begin, query_end;   // 这些命中在 query 上的范围 [begin, end]
+            uint32_t target_begin, target_end; // 这些命中在 target 上的范围 [begin, end]
+        };
+
+    private:
+        std::vector<Entry> entries; // 按 hash 排序
+        size_t max_occurrence;
+
+    public:
+        explicit MinimizerIndex(size_t max_occurrence = 1000) : max_occurrence(max_occurrence) {}
+
+        [[nodiscard]] size_t size() const { return entries.size(); }
+
+        // 批量构建索引, 覆盖之前的内容. 提取 minimizer 在 read 之间并行.
+        void build(const std::vector<std::string> &reads, const std::vector<Label> &labels) {
+            assert(reads.size() == labels.size());
+            std::vector<std::vector<Minimizer>> minimizers(reads.size());
+#pragma omp parallel for schedule(dynamic, 16)
+            for (size_t i = 0; i < reads.size(); i++) minimizers[i] = dna_minimizers<k, w, canonical>(reads[i]);
+            std::vector<Entry> all;
+            size_t total = 0;
+            for (const auto &list : minimizers) total += list.size();
+            all.reserve(total);
+            for (size_t i = 0; i < reads.size(); i++) {
+                for (const auto &minimizer : minimizers[i]) {
+                    all.push_back(Entry{minimizer.hash, labels[i], minimizer.position, minimizer.reverse});
+                }
+                std::vector<Minimizer>().swap(minimizers[i]);
+            }
+            auto compare = [](const Entry &a, const Entry &b) { return a.hash < b.hash; };
+#ifdef USE_CXX_PARALLISM_TS
+            std::stable_sort(std::execution::par, all.begin(), all.end(), compare);
+#else
+            std::stable_sort(all.begin(), all.end(), compare);
+#endif
+            // 去掉高频 minimizer
+            entries.clear();
+            entries.reserve(all.size());
+            for (size_t i = 0; i < all.size();) {
+                size_t j = i;
+                while (j < all.size() && all[j].hash == all[i].hash) j++;
+                if (j - i <= max_occurrence) entries.insert(entries.end(), all.begin() + i, all.begin() + j);
+                i = j;
+            }
+            entries.shrink_to_fit();
+        }
+
+        // 查询 read 的所有命中, 按 { label, target_position } 排序
+        std::vector<Hit> query(const std::string_view &read) const {
+            std::vector<Hit> hits;
+            for (const auto &minimizer : dna_minimizers<k, w, canonical>(read)) {
+                auto first = std::lower_bound(entries.begin(), entries.end(), minimizer.hash,
+                                              [](const Entry &entry, uint64_t hash) { return entry.hash < hash; });
+                for (auto entry = first; entry != entries.end() && entry->hash == minimizer.hash; entry++) {
+                    hits.push_back(Hit{entry->label, minimizer.position, entry->position,
+                                       entry->reverse == minimizer.reverse});
+                }
+            }
+            std::sort(hits.begin(), hits.end(), [](const Hit &a, const Hit &b) {
+                return std::tie(a.label, a.target_position) < std::tie(b.label, b.target_position);
+            });
+            return hits;
+        }
+
+        /**
+         * 查询与 read 重叠的 read: 对每个 { label, 链方向 }, 同链时对角线为 target - query, 反向互补时为 target + query,
+         * 对角线排序以后用滑动窗口找到跨度不超过 2 * band_width (允许 indel 造成的对角线偏移) 的命中最多的区间.
+         * 返回命中个数 >= min_hits 的结果, 按命中个数递减排序.
+         */
+        std::vector<Overlap> overlap(const std::string_view &read, size_t min_hits = 3, size_t band_width = 500) const {
+            std::vector<Overlap> result;
+            auto hits = query(read);
+            std::vector<std::pair<int64_t, const Hit *>> diagonals;
+            for (size_t i = 0; i < hits.size();) {
+                size_t j = i;
+                while (j < hits.size() && hits[j].label == hits[i].label) j++;
+                for (bool strand : {true, false}) {
+                    diagonals.clear();
+                    for (size_t t = i; t < j; t++) {
+                        if (hits[t].same_strand != strand) continue;
+                        auto target = static_cast<int64_t>(hits[t].target_position);
+                        auto query_position = static_cast<int64_t>(hits[t].query_position);
+                        int64_t diagonal = strand ? target - query_position : target + query_position;
+                        diagonals.emplace_back(diagonal, &hits[t]);
+                    }
+                    if (diagonals.size() < min_hits) continue;
+                    std::sort(diagonals.begin(), diagonals.end(),
+                              [](const auto &a, const auto &b) { return a.first < b.first; });
+                    const auto band = static_cast<int64_t>(2 * band_width);
+                    size_t best_begin = 0, best_end = 0;
+                    for (size_t left = 0, right = 0; right < diagonals.size(); right++) {
+                        while (diagonals[right].first - diagonals[left].first > band) left++;
+                        if (right + 1 - left > best_end - best_begin) {
+                            best_begin = left;
+                            best_end = right + 1;
+                        }
+                    }
+                    if (best_end - best_begin < min_hits) continue;
+                    Overlap overlap{hits[i].label, strand, best_end - best_begin,
+                                    std::numeric_limits<uint32_t>::max(), 0,
+                                    std::numeric_limits<uint32_t>::max(), 0};
+                    for (size_t t = best_begin; t < best_end; t++) {
+                        const Hit *hit = diagonals[t].second;
+                        overlap.query_begin = std::min(overlap.query_begin, hit->query_position);
+                        overlap.query_end = std::max(overlap.query_end, hit->query_position);
+                        overlap.target_begin = std::min(overlap.target_begin, hit->target_position);
+                        overlap.target_end = std::max(overlap.target_end, hit->target_position);
+                    }
+                    result.push_back(overlap);
+                }
+                i = j;
+            }
+            std::sort(result.begin(), result.end(),
+                      [](const Overlap &a, const Overlap &b) { return a.n_hits > b.n_hits; });
+            return result;
+        }
+
+        // 批量查询重叠, 多个查询之间并行
+        std::vector<std::vector<Overlap>>
+        overlap(const std::vector<std::string> &reads, size_t min_hits = 3, size_t band_width = 500) const {
+            std::vector<std::vector<Overlap>> result(reads.size());
+#pragma omp parallel for schedule(dynamic, 16)
+            for (size_t i = 0; i < reads.size(); i++) result[i] = overlap(reads[i], min_hits, band_width);
+            return result;
+        }
+    };
+}
+#endif //LSH_CPP_MINIMIZER_H
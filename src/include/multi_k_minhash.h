@@ -0,0 +1,121 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_MULTI_K_MINHASH_H
+#define LSH_CPP_MULTI_K_MINHASH_H
+
+#include "lsh_cpp.h"
+#include "k_shingles.h"
+#include "minhash.h"
+
+namespace LSH_CPP {
+    /**
+     * 一次遍历 read 同时计算多个 k 的 DNA MinHash (参数扫描 / 多分辨率索引时每条 read 只需要读一次).
+     *
+     * 滚动计算最大的 k 的 2-bit 编码 (和 dna_kmer_code_count 相同, 第一个碱基在最高位), 新碱基总是在最低 2 位,
+     * 所以以当前位置结尾的长度为 k' 的 k-mer 的编码就是滚动编码的低 2k' 位. 每个位置对每个 k 只需要一次与运算,
+     * 编码去重以后转换为 DNA_Shingling<k, no_weight> 更新对应的 MinHash, 哈希值与 split_dna_shingling 完全相同.
+     * 含有非 ACGT 字符的 k-mer 会被跳过 (与 dna_kmer_code_count 相同); 长度小于 k 的 read 对这个 k 没有 k-mer.
+     *
+     * example:
+     * template<size_t k> using DNAMinHash = MinHash<StdDNAShinglingHash64<k>, 32, 512>;
+     * MultiKMinHash<DNAMinHash, 5, 6, 7, 8, 9> sketch;
+     * sketch.update(read);
+     * auto &minhash_7 = sketch.get<7>(); // 等于 DNAMinHash<7>{}.update(split_dna_shingling<7, no_weight>(read))
+     *
+     * @tparam MinHashTypeOf k -> MinHash 类型, 哈希函数需要接受 DNA_Shingling<k, WeightFlag::no_weight>
+     * @tparam ks 需要计算的 k (不能重复, 都不超过 32)
+     */
+    template<template<size_t> typename MinHashTypeOf, size_t ... ks>
+    class MultiKMinHash {
+        static_assert(sizeof...(ks) > 0, "MultiKMinHash needs at least one k.");
+        static_assert(((ks > 0 && ks <= 32) && ...), "k-mer 2-bit code must fit in uint64_t.");
+    public:
+        static constexpr size_t n_k = sizeof...(ks);
+        static constexpr std::array<size_t, n_k> k_values = {ks...};
+        static constexpr size_t k_max = std::max({ks...});
+
+    private:
+        static constexpr uint64_t code_mask(size_t k) {
+            return k == 32 ? ~uint64_t(0) : ((uint64_t(1) << (2 * k)) - 1);
+        }
+
+        template<size_t k>
+        static constexpr size_t index_of() {
+            size_t index = n_k;
+            for (size_t i = 0; i < n_k; i++) if (k_values[i] == k) index = i;
+            return index;
+        }
+
+        std::tuple<MinHashTypeOf<ks>...> sketches;
+
+        // 第 index 个 k 的 k-mer 编码去重后更新 MinHash
+        template<size_t index>
+        void update_codes(std::vector<uint64_t> &codes) {
+            constexpr size_t k = k_values[index];
+            using ShinglingType = DNA_Shingling<k, WeightFlag::no_weight>;
+            std::sort(codes.begin(), codes.end());
+            codes.erase(std::unique(codes.begin(), codes.end()), codes.end());
+            auto &sketch = std::get<index>(sketches);
+            for (const auto &code : codes) sketch.update(ShinglingType{typename ShinglingType::ValueType(code)});
+        }
+
+        template<size_t ... Is>
+        void update_all(std::array<std::vector<uint64_t>, n_k> &codes, std::index_sequence<Is...>) {
+            (update_codes<Is>(codes[Is]), ...);
+        }
+
+        template<size_t ... Is>
+        void merge_all(const MultiKMinHash &other, std::index_sequence<Is...>) {
+            (std::get<Is>(sketches).merge(std::get<Is>(other.sketches)), ...);
+        }
+
+    public:
+        explicit MultiKMinHash() = default;
+
+        // 把一条 read 的所有 k-mer (每个 k) 加入对应的 MinHash
+        void update(const std::string_view &read) {
+            constexpr uint64_t mask = code_mask(k_max);
+            std::array<uint64_t, n_k> masks{};
+            std::array<std::vector<uint64_t>, n_k> codes;
+            for (size_t i = 0; i < n_k; i++) {
+                masks[i] = code_mask(k_values[i]);
+                if (read.size() >= k_values[i]) codes[i].reserve(read.size() - k_values[i] + 1);
+            }
+            uint64_t code = 0;
+            size_t valid = 0; // 当前窗口中连续合法碱基的个数
+            for (const auto &ch : read) {
+                int base = dna_base_code(ch);
+                if (base < 0) {
+                    valid = 0;
+                    continue;
+                }
+                code = ((code << 2u) | static_cast<uint64_t>(base)) & mask;
+                valid++;
+                for (size_t i = 0; i < n_k; i++) {
+                    if (valid >= k_values[i]) codes[i].push_back(code & masks[i]);
+                }
+            }
+            update_all(codes, std::make_index_sequence<n_k>{});
+        }
+
+        // 合并另一个 MultiKMinHash, 每个 k 分别逐位置取最小值
+        void merge(const MultiKMinHash &other) {
+            merge_all(other, std::make_index_sequence<n_k>{});
+        }
+
+        template<size_t k>
+        const MinHashTypeOf<k> &get() const {
+            static_assert(index_of<k>() < n_k, "k is not computed by this MultiKMinHash.");
+            return std::get<index_of<k>()>(sketches);
+        }
+
+        template<size_t k>
+        MinHashTypeOf<k> &get() {
+            static_assert(index_of<k>() < n_k, "k is not computed by this MultiKMinHash.");
+            return std::get<index_of<k>()>(sketches);
+        }
+    };
+}
+#endif //LSH_CPP_MULTI_K_MINHASH_H
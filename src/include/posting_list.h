@@ -0,0 +1,253 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_POSTING_LIST_H
+#define LSH_CPP_POSTING_LIST_H
+
+#include "lsh_cpp.h"
+
+namespace LSH_CPP {
+    namespace detail {
+        // varint 编码到 out, 返回写入的字节数 (最多 10 个字节)
+        inline size_t varint_encode(uint8_t *out, uint64_t value) {
+            size_t n = 0;
+            while (value >= 0x80u) {
+                out[n++] = static_cast<uint8_t>(value | 0x80u);
+                value >>= 7u;
+            }
+            out[n++] = static_cast<uint8_t>(value);
+            return n;
+        }
+
+        inline uint64_t varint_decode(const uint8_t *&p) {
+            uint64_t value = 0;
+            uint32_t shift = 0;
+            while (*p & 0x80u) {
+                value |= static_cast<uint64_t>(*p++ & 0x7Fu) << shift;
+                shift += 7;
+            }
+            value |= static_cast<uint64_t>(*p++) << shift;
+            return value;
+        }
+    }
+
+    /**
+     * 压缩的 LSH bucket (posting list), 可以作为 LSH 的 Bucket 模板参数替换 std::vector<MinHashLabel>.
+     * 整数 label 基本按递增顺序插入时,相邻 label 的差值很小,用 delta + varint 编码后每个 label 只需要 1~2 个字节.
+     *
+     * 编码: 按插入顺序, 每个 label 编码为 varint(zigzag(label - 上一个 label)), 第一个 label 和 0 做差.
+     * 每次 push_back 只在末尾追加一个 varint, 所以任意长度的 bucket 都是压缩的 (不存在未压缩的尾部);
+     * 差值用 zigzag 编码, 乱序插入也只是多占一两个字节. 遍历时用 const_iterator 边解码边返回, 顺序就是插入顺序.
+     *
+     * LSH 的 bucket 绝大多数只有几个 label, 所以编码数据不超过 inline_capacity (23) 个字节时直接存放在对象内部,
+     * 不分配堆内存, 追加时解码这几个字节得到上一个 label; 超过以后搬到堆上, 堆内存的开头缓存上一个 label.
+     * 对象和 std::vector 一样是 24 字节, 而 std::vector 每个 label 还要 8 字节的堆内存, 所以任意大小的 bucket 都更省内存.
+     * size() 需要扫描一遍编码数据 (数 varint 的结束字节), LSH 的插入和查询不会用到它.
+     *
+     * 整个 band 哈希表能省多少内存取决于每个 key 平均有多少个 label: 每个 entry 固定占 8 字节的 key + 24 字节的 bucket,
+     * 压缩只能减少 label 本身的 8 字节 (递增插入时约 1 字节). 设 K 个 key, N 个 label, 压缩比约为
+     * (32K + 8N) / (32K + N). N/K = 1.3 (绝大多数文档没有近似重复) 时只有约 1.3x; 要达到 3x 需要 N/K >= 13,
+     * 5x 需要 N/K >= 43. 用 LSH::key_size() / label_size() 可以得到实际数据的 N/K,
+     * dna_benchmark 中的 posting_list_memory() 在 SRA 数据的 band 哈希表上输出这组数字.
+     *
+     * @tparam Label 整数类型的 label
+     */
+    template<typename Label>
+    class CompressedPostingList {
+        static_assert(std::is_integral_v<Label>, "CompressedPostingList only supports integer label.");
+
+    private:
+        using UnsignedLabel = std::make_unsigned_t<Label>;
+        using SignedLabel = std::make_signed_t<Label>;
+        static constexpr size_t inline_capacity = 23;
+        static constexpr uint8_t heap_tag = 0xFF;
+
+        // 堆存储: data 的前 sizeof(UnsignedLabel) 个字节是上一个 label, 后面是 size 个字节的编码数据
+        struct HeapStorage {
+            uint8_t *data;
+            uint32_t size;
+            uint32_t capacity;
+        };
+
+        // 对象内部的 24 个字节: 前 23 个字节是 inline 的编码数据或者 HeapStorage, 最后一个字节是 inline 数据的长度,
+        // 等于 heap_tag 表示数据在堆上. 用 memcpy 读写 HeapStorage, 避免通过 union 做类型双关.
+        alignas(HeapStorage) uint8_t storage[inline_capacity + 1]{};
+
+        [[nodiscard]] bool on_heap() const { return storage[inline_capacity] == heap_tag; }
+
+        [[nodiscard]] HeapStorage heap() const {
+            HeapStorage heap_storage{};
+            std::memcpy(&heap_storage, storage, sizeof(HeapStorage));
+            return heap_storage;
+        }
+
+        void set_heap(const HeapStorage &heap_storage) {
+            std::memcpy(storage, &heap_storage, sizeof(HeapStorage));
+            storage[inline_capacity] = heap_tag;
+        }
+
+        [[nodiscard]] const uint8_t *encoded() const {
+            return on_heap() ? heap().data + sizeof(UnsignedLabel) : storage;
+        }
+
+        [[nodiscard]] size_t encoded_size() const { return on_heap() ? heap().size : storage[inline_capacity]; }
+
+        [[nodiscard]] UnsignedLabel last_label() const {
+            UnsignedLabel last = 0;
+            if (on_heap()) {
+                std::memcpy(&last, heap().data, sizeof(UnsignedLabel));
+            } else {
+                for (const uint8_t *p = storage; p < storage + storage[inline_capacity];) {
+                    last += unzigzag(detail::varint_decode(p));
+                }
+            }
+            return last;
+        }
+
+        // 把编码数据搬到容量为 capacity 的堆内存中; capacity <= inline_capacity 时搬回对象内部
+        void reallocate(size_t capacity) {
+            const size_t size = encoded_size();
+            uint8_t *old_heap = on_heap() ? heap().data : nullptr;
+            if (capacity <= inline_capacity) {
+                if (old_heap == nullptr) return;
+                std::memcpy(storage, old_heap + sizeof(UnsignedLabel), size);
+                storage[inline_capacity] = static_cast<uint8_t>(size);
+            } else {
+                const UnsignedLabel last = last_label();
+                auto *data = new uint8_t[sizeof(UnsignedLabel) + capacity];
+                std::memcpy(data, &last, sizeof(UnsignedLabel));
+                std::memcpy(data + sizeof(UnsignedLabel), encoded(), size);
+                set_heap(HeapStorage{data, static_cast<uint32_t>(size), static_cast<uint32_t>(capacity)});
+            }
+            delete[] old_heap;
+        }
+
+        static uint64_t zigzag(UnsignedLabel delta) {
+            auto d = static_cast<SignedLabel>(delta);
+            return static_cast<UnsignedLabel>(static_cast<UnsignedLabel>(d) << 1u) ^
+                   static_cast<UnsignedLabel>(d >> (sizeof(Label) * 8 - 1));
+        }
+
+        static UnsignedLabel unzigzag(uint64_t value) {
+            auto v = static_cast<UnsignedLabel>(value);
+            return static_cast<UnsignedLabel>((v >> 1u) ^ (~(v & 1u) + 1u));
+        }
+
+    public:
+        using value_type = Label;
+
+        class const_iterator {
+        private:
+            const uint8_t *current; // 当前 label 的 varint 起始位置, 等于 end 表示结束
+            const uint8_t *next;    // 下一个 label 的 varint 起始位置
+            const uint8_t *end;
+            UnsignedLabel value;
+
+            void decode() {
+                if (current == end) return;
+                next = current;
+                value += unzigzag(detail::varint_decode(next));
+            }
+
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = Label;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const Label *;
+            using reference = Label;
+
+            const_iterator(const uint8_t *begin, const uint8_t *end) :
+                    current(begin), next(begin), end(end), value(0) { decode(); }
+
+            Label operator*() const { return static_cast<Label>(value); }
+
+            const_iterator &operator++() {
+                current = next;
+                decode();
+                return *this;
+            }
+
+            bool operator==(const const_iterator &other) const { return current == other.current; }
+
+            bool operator!=(const const_iterator &other) const { return !(*this == other); }
+        };
+
+        CompressedPostingList() = default;
+
+        // 兼容 LSH 中 BandHashValueType{label} 的构造方式
+        CompressedPostingList(std::initializer_list<Label> labels) {
+            for (const auto &label : labels) push_back(label);
+        }
+
+        CompressedPostingList(const CompressedPostingList &other) {
+            if (other.on_heap()) {
+                const HeapStorage other_heap = other.heap();
+                auto *data = new uint8_t[sizeof(UnsignedLabel) + other_heap.size];
+                std::memcpy(data, other_heap.data, sizeof(UnsignedLabel) + other_heap.size);
+                set_heap(HeapStorage{data, other_heap.size, other_heap.size});
+            } else {
+                std::memcpy(storage, other.storage, sizeof(storage));
+            }
+        }
+
+        CompressedPostingList(CompressedPostingList &&other) noexcept {
+            std::memcpy(storage, other.storage, sizeof(storage)); // 堆存储时复制的是 HeapStorage, 接管堆内存
+            other.storage[inline_capacity] = 0;
+        }
+
+        CompressedPostingList &operator=(CompressedPostingList other) noexcept {
+            std::swap(storage, other.storage);
+            return *this;
+        }
+
+        ~CompressedPostingList() { if (on_heap()) delete[] heap().data; }
+
+        void push_back(const Label &label) {
+            uint8_t buffer[10];
+            const auto value = static_cast<UnsignedLabel>(label);
+            const size_t length = detail::varint_encode(buffer, zigzag(static_cast<UnsignedLabel>(value - last_label())));
+            const size_t size = encoded_size();
+            const size_t capacity = on_heap() ? heap().capacity : inline_capacity;
+            if (size + length > capacity) reallocate(std::max<size_t>(2 * capacity, size + length));
+            if (on_heap()) {
+                HeapStorage heap_storage = heap();
+                std::memcpy(heap_storage.data + sizeof(UnsignedLabel) + size, buffer, length);
+                std::memcpy(heap_storage.data, &value, sizeof(UnsignedLabel));
+                heap_storage.size += static_cast<uint32_t>(length);
+                set_heap(heap_storage);
+            } else {
+                std::memcpy(storage + size, buffer, length);
+                storage[inline_capacity] = static_cast<uint8_t>(size + length);
+            }
+        }
+
+        [[nodiscard]] size_t size() const {
+            const uint8_t *p = encoded();
+            size_t count = 0;
+            for (size_t i = 0; i < encoded_size(); i++) count += (p[i] & 0x80u) == 0;
+            return count;
+        }
+
+        [[nodiscard]] bool empty() const { return encoded_size() == 0; }
+
+        const_iterator begin() const { return const_iterator(encoded(), encoded() + encoded_size()); }
+
+        const_iterator end() const { return const_iterator(encoded() + encoded_size(), encoded() + encoded_size()); }
+
+        void shrink_to_fit() {
+            if (on_heap() && heap().capacity > heap().size) reallocate(heap().size);
+        }
+
+        // 占用的堆内存字节数
+        [[nodiscard]] size_t heap_bytes() const { return on_heap() ? sizeof(UnsignedLabel) + heap().capacity : 0; }
+    };
+
+    // bucket 占用的堆内存字节数, 用于统计 LSH 的内存开销
+    template<typename Label>
+    size_t bucket_heap_bytes(const std::vector<Label> &bucket) { return bucket.capacity() * sizeof(Label); }
+
+    template<typename Label>
+    size_t bucket_heap_bytes(const CompressedPostingList<Label> &bucket) { return bucket.heap_bytes(); }
+}
+#endif //LSH_CPP_POSTING_LIST_H
@@ -0,0 +1,138 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_PROB_MINHASH_H
+#define LSH_CPP_PROB_MINHASH_H
+
+#include "lsh_cpp.h"
+#include "util.h"
+#include "weight_minhash.h"
+
+namespace LSH_CPP {
+    namespace detail {
+        /**
+         * 维护 n 个值的最大值 (ProbMinHash 的提前终止条件).
+         * 完全二叉树存储在数组中, 叶子在 [n, 2n), 节点 i 的值是两个子节点的最大值, 根节点 1 就是全局最大值.
+         * 叶子的值只会变小, 更新时沿路径向上重新计算, 某个节点的值没有变化就可以停止.
+         */
+        template<size_t n>
+        class MaxValueTracker {
+        private:
+            std::array<double, 2 * n> tree;
+
+        public:
+            MaxValueTracker() { tree.fill(std::numeric_limits<double>::max()); }
+
+            void update(size_t index, double value) {
+                size_t i = index + n;
+                tree[i] = value;
+                for (i >>= 1u; i >= 1; i >>= 1u) {
+                    double new_max = std::max(tree[2 * i], tree[2 * i + 1]);
+                    if (tree[i] == new_max) break;
+                    tree[i] = new_max;
+                }
+            }
+
+            [[nodiscard]] double max() const { return tree[1]; }
+        };
+    }
+
+    /**
+     * ProbMinHash (ProbMinHash1, Ertl 2020, "ProbMinHash – A Class of Locality-Sensitive Hash Algorithms for the
+     * (Probability) Jaccard Similarity"), 估计的是 probability jaccard similarity:
+     *   J_P(A, B) = \sum_{i: A_i>0, B_i>0} 1 / \sum_j max(A_j / A_i, B_j / B_i)
+     * J_P 和 generalized jaccard 一样在 [0,1] 之间, 对整体缩放不变 (比如两个 read 长度不同时的 k-mer 计数).
+     *
+     * 每个元素 d 生成一个速率为 w_d 的泊松过程 x_1 < x_2 < ..., 每个点随机分配到一个采样 k, 采样 k 记录最小的点所属的元素.
+     * 当前点大于所有采样记录的最大值时, 这个元素后面的点都不可能再更新任何采样, 直接结束.
+     * 所以每个元素平均只需要生成很少几个点, 总的计算量约为 O(nnz + sample_size * log(sample_size)),
+     * 而 ICWS 需要 O(nnz * sample_size) 次 log/floor 计算.
+     *
+     * 元素编号可以是任意 64 位整数 (权重向量的下标, k-mer 的 2-bit 编码等), 不需要预先知道维度, 也不需要采样矩阵.
+     * hash_values[k] 是采样 k 选中的元素编号, 两个 sketch 相同位置相等的比例就是 J_P 的无偏估计.
+     */
+    template<size_t sample_size = 128, size_t seed = 1>
+    class ProbMinHash {
+    private:
+        std::vector<double> min_values; // 每个采样当前最小的点, double 最大值表示还没有任何元素
+        detail::MaxValueTracker<sample_size> max_tracker;
+
+    public:
+        std::vector<uint64_t> hash_values;
+
+        explicit ProbMinHash() : min_values(sample_size, std::numeric_limits<double>::max()),
+                                 hash_values(sample_size, 0) {}
+
+        // 加入权重为 weight 的元素 element, 每个元素只应该加入一次. weight <= 0 时忽略.
+        template<typename WeightType, typename = std::enable_if_t<std::is_arithmetic_v<WeightType>>>
+        void update(uint64_t element, WeightType weight) {
+            if (!(weight > 0)) return;
+            const double inv_weight = 1.0 / static_cast<double>(weight);
+            detail::SplitMix64 random(detail::fmix64(element) ^ detail::fmix64(seed + 0x9E3779B97F4A7C15ull));
+            double x = random.exponential() * inv_weight;
+            while (x < max_tracker.max()) {
+                size_t k = random.uniform(sample_size);
+                if (x < min_values[k]) {
+                    min_values[k] = x;
+                    hash_values[k] = element;
+                    max_tracker.update(k, x);
+                }
+                x += random.exponential() * inv_weight;
+            }
+        }
+
+        // 稠密权重向量, 下标作为元素编号
+        template<typename WeightType, typename = std::enable_if_t<std::is_arithmetic_v<WeightType>>>
+        void update(const std::vector<WeightType> &weight_vector) {
+            for (size_t i = 0; i < weight_vector.size(); i++) update(static_cast<uint64_t>(i), weight_vector[i]);
+        }
+
+        // 稀疏权重向量 { element, weight }, 比如 dna_kmer_code_count<k>(read) 的结果
+        template<typename Index, typename WeightType,
+                typename = std::enable_if_t<std::is_integral_v<Index> && std::is_arithmetic_v<WeightType>>>
+        void update(const std::vector<std::pair<Index, WeightType>> &sparse_weight_vector) {
+            for (const auto &[element, weight] : sparse_weight_vector) update(static_cast<uint64_t>(element), weight);
+        }
+
+        [[nodiscard]] bool empty() const { return max_tracker.max() == std::numeric_limits<double>::max(); }
+    };
+
+    // 计算两个 ProbMinHash 的相似度, 估计的是 probability jaccard similarity
+    template<size_t sample_size, size_t seed>
+    double weight_minhash_jaccard(const ProbMinHash<sample_size, seed> &A, const ProbMinHash<sample_size, seed> &B) {
+        return (double) detail::count_equal(A.hash_values.data(), B.hash_values.data(), sample_size) /
+               (double) (sample_size);
+    }
+
+    // 计算稀疏权重向量 { index, weight } (按 index 递增排序) 实际的 probability jaccard similarity,
+    // J_P(A, B) = \sum_{i: A_i>0, B_i>0} 1 / \sum_j max(A_j / A_i, B_j / B_i).
+    // 直接按定义计算, 复杂度 O(|A ∩ B| * |A ∪ B|), 只用于测试和 benchmark 中的 ground truth.
+    template<typename Index, typename WeightType,
+            typename = std::enable_if_t<std::is_integral_v<Index> && std::is_arithmetic_v<WeightType>>>
+    double probability_jaccard_similarity(const std::vector<std::pair<Index, WeightType>> &A,
+                                          const std::vector<std::pair<Index, WeightType>> &B) {
+        // 合并成 { A_j, B_j } 的并集
+        std::vector<std::pair<double, double>> merged;
+        merged.reserve(A.size() + B.size());
+        size_t i = 0, j = 0;
+        while (i < A.size() || j < B.size()) {
+            if (j == B.size() || (i < A.size() && A[i].first < B[j].first)) {
+                merged.emplace_back(A[i++].second, 0);
+            } else if (i == A.size() || B[j].first < A[i].first) {
+                merged.emplace_back(0, B[j++].second);
+            } else {
+                merged.emplace_back(A[i++].second, B[j++].second);
+            }
+        }
+        double similarity = 0;
+        for (const auto &[a_i, b_i] : merged) {
+            if (!(a_i > 0 && b_i > 0)) continue;
+            double sum = 0;
+            for (const auto &[a_j, b_j] : merged) sum += std::max(a_j / a_i, b_j / b_i);
+            similarity += 1.0 / sum;
+        }
+        return similarity;
+    }
+}
+#endif //LSH_CPP_PROB_MINHASH_H
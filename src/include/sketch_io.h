@@ -0,0 +1,341 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_SKETCH_IO_H
+#define LSH_CPP_SKETCH_IO_H
+
+#include "lsh_cpp.h"
+#include "hash.h"
+#include "minhash.h"
+
+namespace LSH_CPP {
+    /**
+     * 哈希函数编号, 写入 sketch 文件头, load 时检查文件中的 sketch 是否用同一个哈希函数计算 (不同的哈希函数得到的 sketch 不能比较).
+     * 没有特化的哈希函数不能保存, 自定义的哈希函数需要特化这个 trait 并使用 1000 以后的编号.
+     * k 是 DNA k-mer 的长度, 其他哈希函数为 0.
+     */
+    template<typename HashFunc>
+    struct SketchHashFunction;
+
+#define LSH_CPP_SKETCH_HASH_FUNCTION(HashFunc, hash_id) \
+    template<> \
+    struct SketchHashFunction<HashFunc> { \
+        static constexpr uint32_t id = hash_id; \
+        static constexpr uint32_t k = 0; \
+    };
+
+    LSH_CPP_SKETCH_HASH_FUNCTION(XXStringViewHash64, 1)
+    LSH_CPP_SKETCH_HASH_FUNCTION(XXStringViewHash32, 2)
+    LSH_CPP_SKETCH_HASH_FUNCTION(XXStringHash64, 3)
+    LSH_CPP_SKETCH_HASH_FUNCTION(XXStringHash32, 4)
+    LSH_CPP_SKETCH_HASH_FUNCTION(XXKShinglingHash64, 5)
+    LSH_CPP_SKETCH_HASH_FUNCTION(XXKShinglingHash32, 6)
+    LSH_CPP_SKETCH_HASH_FUNCTION(XXUInt64Hash64, 7)
+    LSH_CPP_SKETCH_HASH_FUNCTION(XXUInt64Hash32, 8)
+#undef LSH_CPP_SKETCH_HASH_FUNCTION
+
+    template<size_t k_mer, auto flag>
+    struct SketchHashFunction<hash<std_Hash, DNA_Shingling<k_mer, flag>, 64>> {
+        static constexpr uint32_t id = 9;
+        static constexpr uint32_t k = static_cast<uint32_t>(k_mer);
+    };
+
+    template<size_t k_mer, auto flag>
+    struct SketchHashFunction<hash<std_Hash, DNA_Shingling<k_mer, flag>, 32>> {
+        static constexpr uint32_t id = 10;
+        static constexpr uint32_t k = static_cast<uint32_t>(k_mer);
+    };
+
+    /**
+     * MinHash sketch 文件 (类似 Mash 的 .msh): 计算一次参考序列的 sketch 以后保存下来, 之后直接 mmap, 不需要重新计算.
+     *
+     * 文件格式 (本机字节序):
+     *   FileHeader                                  哈希函数编号, k, seed, n_permutation, MinHashBits, sketch 个数
+     *   name offsets: uint64_t[n_sketches + 1]      第 i 个名字为 names[offsets[i], offsets[i + 1])
+     *   names: char[]                               所有名字连续保存 (不以 '\0' 结尾)
+     *   padding                                     sketch 矩阵按 64 字节对齐
+     *   matrix: ValueType[n_sketches][n_permutation] 每行一个 sketch, MinHashBits = 32 时每个值只占 4 字节
+     * load / try_load 时只检查文件头和名字偏移, 名字和矩阵都直接指向 mmap 的内存, 没有任何解析和拷贝.
+     * 写入 / 读取失败时抛出异常 (std::system_error / std::runtime_error), 不会退出进程.
+     * concat / subset 直接拷贝矩阵的行, 不需要原始序列. 文件在 SketchFile 析构 (或者下一次 load) 之前不能被修改.
+     *
+     * @tparam MinHashType MinHash<HashFunc, MinHashBits, n_permutation, Seed, RandomGenerator>, 哈希函数需要特化 SketchHashFunction.
+     * 注意 RandomGenerator 不写入文件头, 保存和读取的 MinHash 必须使用同样的随机数生成器 (默认都是 std::mt19937_64).
+     */
+    template<typename MinHashType>
+    class SketchFile;
+
+    template<typename HashFunc, size_t MinHashBits, size_t n_permutation, size_t Seed, typename RandomGenerator>
+    class SketchFile<MinHash<HashFunc, MinHashBits, n_permutation, Seed, RandomGenerator>> {
+    public:
+        using MinHashType = MinHash<HashFunc, MinHashBits, n_permutation, Seed, RandomGenerator>;
+        using ValueType = typename HashValueType<MinHashBits>::type;
+        static constexpr size_t matrix_alignment = 64;
+
+    private:
+        struct FileHeader {
+            char magic[8];
+            uint64_t version;
+            uint32_t hash_function_id;
+            uint32_t k;
+            uint64_t seed;
+            uint64_t permutations;
+            uint64_t hash_bits;
+            uint64_t n_sketches;
+            uint64_t names_size;    // names 的字节数
+            uint64_t matrix_offset; // 矩阵在文件中的位置
+        };
+        static constexpr char file_magic[8] = {'L', 'S', 'H', 'S', 'K', 'T', 'C', 'H'};
+        static constexpr uint64_t file_version = 1;
+
+        static FileHeader make_header(size_t n_sketches, size_t names_size) {
+            FileHeader header{};
+            std::memcpy(header.magic, file_magic, sizeof(file_magic));
+            header.version = file_version;
+            header.hash_function_id = SketchHashFunction<HashFunc>::id;
+            header.k = SketchHashFunction<HashFunc>::k;
+            header.seed = Seed;
+            header.permutations = n_permutation;
+            header.hash_bits = MinHashBits;
+            header.n_sketches = n_sketches;
+            header.names_size = names_size;
+            size_t offset = sizeof(FileHeader) + (n_sketches + 1) * sizeof(uint64_t) + names_size;
+            header.matrix_offset = (offset + matrix_alignment - 1) / matrix_alignment * matrix_alignment;
+            return header;
+        }
+
+        /**
+         * 写入 n 个 sketch: name(i) 返回第 i 个名字, row(i) 返回第 i 行 (n_permutation 个 ValueType).
+         * 先写到 path.tmp 再 rename, 写入失败或者中途退出不会破坏已有的文件 (可能正在被其他进程 mmap).
+         */
+        template<typename NameFunc, typename RowFunc>
+        static void write(const std::string &path, size_t n, NameFunc &&name, RowFunc &&row) {
+            std::vector<uint64_t> offsets(n + 1, 0);
+            for (size_t i = 0; i < n; i++) offsets[i + 1] = offsets[i] + name(i).size();
+            FileHeader header = make_header(n, offsets[n]);
+            const std::string temp_path = path + ".tmp";
+            std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+            if (!out) throw_io_error("create", temp_path);
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char *>(offsets.data()),
+                      static_cast<std::streamsize>(offsets.size() * sizeof(uint64_t)));
+            for (size_t i = 0; i < n; i++) {
+                auto value = name(i);
+                out.write(value.data(), static_cast<std::streamsize>(value.size()));
+            }
+            size_t padding = header.matrix_offset - (sizeof(FileHeader) + (n + 1) * sizeof(uint64_t) + offsets[n]);
+            const char zeros[matrix_alignment] = {};
+            out.write(zeros, static_cast<std::streamsize>(padding));
+            for (size_t i = 0; i < n; i++) {
+                out.write(reinterpret_cast<const char *>(row(i)),
+                          static_cast<std::streamsize>(n_permutation * sizeof(ValueType)));
+            }
+            out.close();
+            if (!out || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+                int error = errno;
+                std::remove(temp_path.c_str());
+                errno = error;
+                throw_io_error("write", path);
+            }
+        }
+
+        [[noreturn]] static void throw_io_error(const char *operation, const std::string &path) {
+            throw std::system_error(errno, std::generic_category(), std::string(operation) + " sketch file " + path);
+        }
+
+        // 文件头和 MinHashType 一致, 并且文件长度等于文件头描述的长度 (没有被截断). 先限制个数再计算长度, 乘法不会溢出.
+        static bool valid_header(const FileHeader &file_header, size_t length) {
+            if (std::memcmp(file_header.magic, file_magic, sizeof(file_magic)) != 0 ||
+                file_header.version != file_version || file_header.names_size > length ||
+                file_header.n_sketches > length / sizeof(uint64_t)) {
+                return false;
+            }
+            FileHeader expect = make_header(file_header.n_sketches, file_header.names_size);
+            return file_header.hash_function_id == expect.hash_function_id && file_header.k == expect.k &&
+                   file_header.seed == expect.seed && file_header.permutations == expect.permutations &&
+                   file_header.hash_bits == expect.hash_bits && file_header.matrix_offset == expect.matrix_offset &&
+                   expect.matrix_offset <= length &&
+                   file_header.n_sketches == (length - expect.matrix_offset) / (n_permutation * sizeof(ValueType)) &&
+                   length == expect.matrix_offset + file_header.n_sketches * n_permutation * sizeof(ValueType);
+        }
+
+        // 名字的偏移从 0 开始, 单调不减, 最后一个等于 names_size, 这样 name(i) 不会读到 mmap 的范围以外
+        static bool valid_names(const uint64_t *offsets, const FileHeader &file_header) {
+            if (offsets[0] != 0 || offsets[file_header.n_sketches] != file_header.names_size) return false;
+            for (size_t i = 0; i < file_header.n_sketches; i++) {
+                if (offsets[i] > offsets[i + 1]) return false;
+            }
+            return true;
+        }
+
+        enum class LoadStatus {
+            ok, io_error, mismatch
+        };
+
+        // mmap 并检查 path, 成功时替换当前内容; 失败时之前的内容不变, io_error 时 errno 为失败原因
+        LoadStatus map_file(const std::string &path) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return LoadStatus::io_error;
+            struct stat file_stat{};
+            FileHeader file_header{};
+            if (::fstat(fd, &file_stat) != 0) {
+                int error = errno;
+                ::close(fd);
+                errno = error;
+                return LoadStatus::io_error;
+            }
+            auto length = static_cast<size_t>(file_stat.st_size);
+            if (length < sizeof(FileHeader) || ::pread(fd, &file_header, sizeof(file_header), 0) != sizeof(file_header) ||
+                !valid_header(file_header, length)) {
+                ::close(fd);
+                return LoadStatus::mismatch;
+            }
+            void *address = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+            int error = errno;
+            ::close(fd);
+            if (address == MAP_FAILED) {
+                errno = error;
+                return LoadStatus::io_error;
+            }
+            const auto *base = static_cast<const char *>(address);
+            const auto *offsets = reinterpret_cast<const uint64_t *>(base + sizeof(FileHeader));
+            if (!valid_names(offsets, file_header)) {
+                ::munmap(address, length);
+                return LoadStatus::mismatch;
+            }
+            unmap();
+            mapped_address = address;
+            mapped_length = length;
+            header = reinterpret_cast<const FileHeader *>(base);
+            name_offsets = offsets;
+            names = reinterpret_cast<const char *>(name_offsets + header->n_sketches + 1);
+            matrix = reinterpret_cast<const ValueType *>(base + header->matrix_offset);
+            return LoadStatus::ok;
+        }
+
+        const FileHeader *header = nullptr;
+        const uint64_t *name_offsets = nullptr;
+        const char *names = nullptr;
+        const ValueType *matrix = nullptr;
+        void *mapped_address = nullptr;
+        size_t mapped_length = 0;
+
+        void unmap() {
+            if (mapped_address != nullptr) ::munmap(mapped_address, mapped_length);
+            mapped_address = nullptr;
+            mapped_length = 0;
+            header = nullptr;
+            name_offsets = nullptr;
+            names = nullptr;
+            matrix = nullptr;
+        }
+
+    public:
+        explicit SketchFile() = default;
+
+        explicit SketchFile(const std::string &path) { load(path); }
+
+        SketchFile(const SketchFile &) = delete;
+
+        SketchFile &operator=(const SketchFile &) = delete;
+
+        ~SketchFile() { unmap(); }
+
+        // 保存 sketch 和对应的名字 (label)
+        static void save(const std::string &path, const std::vector<MinHashType> &sketches,
+                         const std::vector<std::string> &sketch_names) {
+            assert(sketches.size() == sketch_names.size());
+            std::vector<ValueType> row(n_permutation);
+            write(path, sketches.size(),
+                  [&](size_t i) { return std::string_view(sketch_names[i]); },
+                  [&](size_t i) {
+                      for (size_t j = 0; j < n_permutation; j++) {
+                          row[j] = static_cast<ValueType>(sketches[i].hash_values[j]);
+                      }
+                      return row.data();
+                  });
+        }
+
+        // 检查 path 是否是当前 MinHashType 的完整 sketch 文件 (文件头一致, 长度和名字偏移正确), 不抛出异常
+        static bool is_valid(const std::string &path) {
+            SketchFile file;
+            return file.try_load(path);
+        }
+
+        // mmap sketch 文件, 覆盖之前的内容. 文件不存在, 文件头和 MinHashType 不一致或者 mmap 失败时返回 false, 之前的内容不变.
+        bool try_load(const std::string &path) { return map_file(path) == LoadStatus::ok; }
+
+        /**
+         * mmap sketch 文件, 覆盖之前的内容, 失败时之前的内容不变.
+         * 打开 / mmap 失败时抛出 std::system_error, 文件头和 MinHashType 不一致 (或者文件损坏) 时抛出 std::runtime_error.
+         * 失败以后需要重新计算的调用者使用 try_load.
+         */
+        void load(const std::string &path) {
+            switch (map_file(path)) {
+                case LoadStatus::ok:
+                    return;
+                case LoadStatus::io_error:
+                    throw_io_error("load", path);
+                case LoadStatus::mismatch:
+                    throw std::runtime_error(
+                            "sketch file " + path + " does not match MinHash<hash id " +
+                            std::to_string(SketchHashFunction<HashFunc>::id) + ", k " +
+                            std::to_string(SketchHashFunction<HashFunc>::k) + ", " + std::to_string(MinHashBits) +
+                            " bits, " + std::to_string(n_permutation) + " permutations, seed " +
+                            std::to_string(Seed) + ">");
+            }
+        }
+
+        [[nodiscard]] size_t size() const { return header == nullptr ? 0 : header->n_sketches; }
+
+        [[nodiscard]] std::string_view name(size_t i) const {
+            return {names + name_offsets[i], name_offsets[i + 1] - name_offsets[i]};
+        }
+
+        // 第 i 个 sketch 的 n_permutation 个最小哈希值 (指向 mmap 的内存, 64 字节对齐的连续矩阵中的一行)
+        [[nodiscard]] const ValueType *row(size_t i) const { return matrix + i * n_permutation; }
+
+        // 第 i 个 sketch 转换为 MinHash (拷贝一行), 可以直接插入 LSH 或者继续 update / merge
+        [[nodiscard]] MinHashType to_minhash(size_t i) const {
+            MinHashType result;
+            std::copy(row(i), row(i) + n_permutation, result.hash_values.begin());
+            return result;
+        }
+
+        // query 与第 i 个 sketch 的 jaccard 相似度估计, 直接在 mmap 的行上比较, 不需要拷贝
+        [[nodiscard]] double jaccard_similarity(const MinHashType &query, size_t i) const {
+            const ValueType *values = row(i);
+            size_t count = 0;
+            for (size_t j = 0; j < n_permutation; j++) count += (static_cast<ValueType>(query.hash_values[j]) == values[j]);
+            return (double) count / (double) n_permutation;
+        }
+
+        // 把多个 sketch 文件按顺序合并为一个文件 (所有文件必须是同一种 MinHashType)
+        static void concat(const std::string &path, const std::vector<std::string> &inputs) {
+            std::vector<std::unique_ptr<SketchFile>> files;
+            std::vector<std::pair<size_t, size_t>> index; // { file, row }
+            for (size_t f = 0; f < inputs.size(); f++) {
+                files.push_back(std::make_unique<SketchFile>(inputs[f]));
+                for (size_t i = 0; i < files.back()->size(); i++) index.emplace_back(f, i);
+            }
+            write(path, index.size(),
+                  [&](size_t i) { return files[index[i].first]->name(index[i].second); },
+                  [&](size_t i) { return files[index[i].first]->row(index[i].second); });
+        }
+
+        // 保存当前文件中 indexes 指定的 sketch (按 indexes 的顺序, 可以重复) 为一个新文件
+        void subset(const std::string &path, const std::vector<size_t> &indexes) const {
+            for (const auto &i : indexes) {
+                if (i >= size()) {
+                    throw std::out_of_range("sketch subset index " + std::to_string(i) + " out of range " +
+                                            std::to_string(size()));
+                }
+            }
+            write(path, indexes.size(),
+                  [&](size_t i) { return name(indexes[i]); },
+                  [&](size_t i) { return row(indexes[i]); });
+        }
+    };
+}
+#endif //LSH_CPP_SKETCH_IO_H
@@ -0,0 +1,111 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_STREAMING_WEIGHT_MINHASH_H
+#define LSH_CPP_STREAMING_WEIGHT_MINHASH_H
+
+#include "lsh_cpp.h"
+#include "counter_random.h"
+#include "weight_minhash.h"
+
+namespace LSH_CPP {
+    /**
+     * 支持权重累加和合并的 WeightMinHash (ICWS).
+     *
+     * ICWS 中每个采样选出 ln_a 最小的元素, 而元素 k 的 ln_a_k = ln_c_k - r_k * (t_k - beta_k + 1),
+     * 其中 t_k = floor(ln(w_k) / r_k + beta_k) 随权重 w_k 单调不减, 所以 ln_a_k 随 w_k 单调不增. 因此:
+     *   1. 元素 k 的权重增加以后, 只需要按新的总权重重新计算 k 的 ln_a, 和每个采样当前的 { min ln_a, k*, t_k* } 比较,
+     *      其他元素的 ln_a 不变, 结果就是累加以后的权重向量的 sketch;
+     *   2. 合并两个部分 sketch 时把对方的权重累加进来, 再对权重改变的元素做 1 的更新, 结果是两个权重向量之和的 sketch.
+     * 权重累加要知道元素当前的总权重, 所以每个 sketch 保存一张 { 元素编号 -> 累计权重 } 的表, 内存和不同元素的个数成正比.
+     * (只保存每个采样最小值的做法只能得到逐元素取 max 的 sketch: 同一个元素 1+1+1 和权重 3 的 sketch 不同.)
+     * 如果权重已经在一个 read / 一个窗口内聚合好了 (比如 dna_kmer_code_count), 也可以直接批量 update.
+     *
+     * 采样参数由 Philox4x32 按 (seed, 元素编号, 采样编号) 生成, 与 WeightMinHash<dim, ..., Philox4x32> 相同,
+     * 所以元素编号取权重向量下标时, 两者对同一个 (累计) 权重向量的 sketch 相同, 可以直接比较.
+     * 元素编号可以是任意 64 位整数 (比如 k-mer 的 2-bit 编码或者元素值的哈希).
+     */
+    template<size_t sample_size = 128, size_t seed = 1>
+    class StreamingWeightMinHash {
+    private:
+        using MinHashValueFirstType = size_t;        // Type of k*
+        using MinHashValueSecondType = int_fast32_t; // Type of t_k*
+        using MinHashValueType = std::pair<MinHashValueFirstType, MinHashValueSecondType>;
+
+        static constexpr RandomSample<0, sample_size, seed, Philox4x32> counter_sample{};
+
+        std::vector<float> min_ln_a; // 每个采样当前最小的 ln_a, float 最大值表示还没有任何元素
+        std::vector<float> best_t;   // 每个采样当前的 t_k*, 由 detail::icws_update_element 更新
+        HashMap<uint64_t, double> weights; // 每个元素的累计权重
+
+        // 元素 element 的总权重变为 total 以后更新各个采样
+        void update_element(uint64_t element, double total) {
+            detail::SampleBuffer<sample_size> buffer;
+            auto params = counter_sample.params(element, buffer);
+            // 和 WeightMinHash 共用 ICWS 内核; 元素编号是 64 位的, 所以只取回成为新最小值的采样, 在这里记录元素编号
+            std::array<uint32_t, sample_size> winners;
+            size_t n_winners = detail::icws_update_element<sample_size>(
+                    std::log(static_cast<float>(total)), 0, params.r, params.ln_c, params.beta,
+                    min_ln_a.data(), best_t.data(), nullptr, winners.data());
+            for (size_t i = 0; i < n_winners; i++) {
+                const uint32_t s = winners[i];
+                hash_values[s] = {static_cast<MinHashValueFirstType>(element),
+                                  static_cast<MinHashValueSecondType>(best_t[s])};
+            }
+        }
+
+    public:
+        std::vector<MinHashValueType> hash_values;
+
+        explicit StreamingWeightMinHash() : min_ln_a(sample_size, std::numeric_limits<float>::max()),
+                                            best_t(sample_size, 0), hash_values(sample_size, {0, 0}) {}
+
+        // 元素 element 的权重增加 weight. weight <= 0 时忽略.
+        template<typename WeightType, typename = std::enable_if_t<std::is_arithmetic_v<WeightType>>>
+        void update(uint64_t element, WeightType weight) {
+            if (!(weight > 0)) return;
+            double &total = weights[element];
+            total += static_cast<double>(weight);
+            update_element(element, total);
+        }
+
+        // 批量更新 { element, weight }, 比如 dna_kmer_code_count<k>(read) 的结果
+        template<typename Index, typename WeightType,
+                typename = std::enable_if_t<std::is_integral_v<Index> && std::is_arithmetic_v<WeightType>>>
+        void update(const std::vector<std::pair<Index, WeightType>> &sparse_weight_vector) {
+            for (const auto &[element, weight] : sparse_weight_vector) update(static_cast<uint64_t>(element), weight);
+        }
+
+        // 合并另一个部分 sketch, 结果是两个权重向量之和的 sketch
+        void merge(const StreamingWeightMinHash &other) {
+            for (const auto &[element, weight] : other.weights) {
+                double &total = weights[element];
+                total += weight;
+                update_element(element, total);
+            }
+        }
+
+        // 元素 element 目前的累计权重
+        [[nodiscard]] double weight(uint64_t element) const {
+            auto pos = weights.find(element);
+            return pos == weights.end() ? 0.0 : (*pos).second;
+        }
+
+        // 不同元素的个数, 也就是累计权重表的大小
+        [[nodiscard]] size_t size() const { return weights.size(); }
+
+        [[nodiscard]] bool empty() const { return min_ln_a[0] == std::numeric_limits<float>::max(); }
+    };
+
+    template<size_t sample_size, size_t seed>
+    double weight_minhash_jaccard(const StreamingWeightMinHash<sample_size, seed> &A,
+                                  const StreamingWeightMinHash<sample_size, seed> &B) {
+        double count = 0;
+        for (size_t i = 0; i < sample_size; i++) {
+            if (A.hash_values[i] == B.hash_values[i]) count++;
+        }
+        return count / (double) (sample_size);
+    }
+}
+#endif //LSH_CPP_STREAMING_WEIGHT_MINHASH_H
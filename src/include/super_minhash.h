@@ -0,0 +1,101 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_SUPER_MINHASH_H
+#define LSH_CPP_SUPER_MINHASH_H
+
+#include "lsh_cpp.h"
+#include "util.h"
+#include "hash.h"
+
+namespace LSH_CPP {
+    /**
+     * SuperMinHash (Ertl 2017, "SuperMinHash – A New Minwise Hashing Algorithm for Jaccard Similarity Estimation").
+     *
+     * 普通 MinHash 的 m 个 permutation 相互独立; SuperMinHash 对每个元素生成 [0, m) 的一个随机排列 π,
+     * 第 j 个 slot 的哈希值取 j + r_j (r_j 为 [0,1) 上的均匀随机数), 也就是在 slot 之间引入了负相关,
+     * 所以 jaccard 估计的方差更小 (相似度越高越明显, J -> 1 时方差趋于 0), 同样的精度需要的 slot 更少.
+     * 随机排列用 Fisher-Yates 洗牌逐步生成, 当 j 已经大于所有 slot 当前值的整数部分时, 后面的位置都不可能再更新,
+     * 直接结束, 所以计算量约为 O(|set| + m log m), 而 MinHash 需要 O(|set| * m).
+     *
+     * hash_values[k] = j * 2^32 + u (u 是 32 位随机整数, 即 r_j = u / 2^32), 和浮点数 j + r_j 的顺序相同,
+     * 两个 sketch 相同位置相等的比例就是 jaccard 相似度的估计, 并且可以直接作为 LSH 的 band 哈希输入.
+     *
+     * @tparam HashFunc 和 MinHash 相同的哈希函数 (XXStringViewHash64, StdDNAShinglingHash64 ...), 哈希值作为元素随机序列的种子.
+     */
+    template<typename HashFunc = XXStringViewHash64,
+            size_t n_permutation = 128,
+            size_t Seed = 1>
+    class SuperMinHash {
+        static_assert(n_permutation > 0 && n_permutation < (size_t(1) << 31u));
+    private:
+        HashFunc hash_func;
+        uint64_t n_elements = 0;              // 已经处理的元素个数, 作为 q 中的元素编号
+        std::vector<uint32_t> permutation;    // p: 当前元素的 Fisher-Yates 洗牌状态
+        std::vector<uint64_t> permutation_id; // q: permutation[j] 属于哪个元素, 不同时需要重新初始化
+        std::vector<uint32_t> histogram;      // b: 每个整数部分 j 上的 slot 个数
+        size_t max_index;                     // a: 所有 slot 当前值的整数部分的最大值
+
+    public:
+        std::vector<uint64_t> hash_values;
+
+        explicit SuperMinHash(HashFunc &&hash_func = HashFunc{})
+                : hash_func(hash_func), permutation(n_permutation, 0),
+                  permutation_id(n_permutation, std::numeric_limits<uint64_t>::max()),
+                  histogram(n_permutation, 0), max_index(n_permutation - 1),
+                  hash_values(n_permutation, std::numeric_limits<uint64_t>::max()) {
+            histogram[n_permutation - 1] = n_permutation;
+        }
+
+        // 直接用 64 位哈希值更新
+        void update_hash(uint64_t hash_value) {
+            const uint64_t id = n_elements++;
+            detail::SplitMix64 random(hash_value ^ (Seed * 0x9E3779B97F4A7C15ull));
+            for (size_t j = 0; j <= max_index; j++) {
+                uint64_t u = random.next() >> 32u;
+                size_t k = j + random.uniform(n_permutation - j);
+                if (permutation_id[j] != id) {
+                    permutation_id[j] = id;
+                    permutation[j] = static_cast<uint32_t>(j);
+                }
+                if (permutation_id[k] != id) {
+                    permutation_id[k] = id;
+                    permutation[k] = static_cast<uint32_t>(k);
+                }
+                std::swap(permutation[j], permutation[k]);
+                uint64_t &slot = hash_values[permutation[j]];
+                uint64_t value = (static_cast<uint64_t>(j) << 32u) | u;
+                if (value < slot) {
+                    size_t old_index = std::min<size_t>(slot >> 32u, n_permutation - 1);
+                    slot = value;
+                    if (j < old_index) {
+                        histogram[old_index]--;
+                        histogram[j]++;
+                        while (histogram[max_index] == 0) max_index--;
+                    }
+                }
+            }
+        }
+
+        template<typename T>
+        void update(const T &val) {
+            update_hash(hash_func(val));
+        }
+
+        template<typename T>
+        void update(const HashSet<T> &data_set) {
+            for (const auto &data : data_set) update(data);
+        }
+    };
+
+    // 由 SuperMinHash 估计 jaccard 相似度
+    template<typename H, size_t n_permutation, size_t Seed>
+    double minhash_jaccard_similarity(const SuperMinHash<H, n_permutation, Seed> &A,
+                                      const SuperMinHash<H, n_permutation, Seed> &B) {
+        size_t count = 0;
+        for (size_t i = 0; i < n_permutation; i++) count += (A.hash_values[i] == B.hash_values[i]);
+        return (double) count / (double) n_permutation;
+    }
+}
+#endif //LSH_CPP_SUPER_MINHASH_H
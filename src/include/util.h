@@ -114,6 +114,33 @@ namespace LSH_CPP {
                 std::make_index_sequence<Bounds0::upper - Bounds0::lower>{});
     }
 
+    namespace detail {
+        // 轻量的 64 位伪随机数生成器, 状态只有一个整数. ProbMinHash / SuperMinHash 用元素的哈希值作为种子,
+        // 同一个元素在任何 sketch 中得到的随机序列都相同.
+        struct SplitMix64 {
+            uint64_t state;
+
+            explicit SplitMix64(uint64_t seed) : state(seed) {}
+
+            inline uint64_t next() {
+                uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+                z = (z ^ (z >> 30u)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27u)) * 0x94D049BB133111EBull;
+                return z ^ (z >> 31u);
+            }
+
+            // 均值为 1 的指数分布, 用高 53 位构造 (0,1] 上的 double 保证 log 有限
+            inline double exponential() {
+                return -std::log(static_cast<double>((next() >> 11u) + 1) * (1.0 / 9007199254740992.0));
+            }
+
+            // [0, n) 上的均匀整数 (n < 2^32, Lemire multiply-shift, 偏差可以忽略)
+            inline size_t uniform(size_t n) {
+                return static_cast<size_t>(((next() >> 32u) * static_cast<uint64_t>(n)) >> 32u);
+            }
+        };
+    }
+
     // static fix-size eigen array declaration:
     template<typename _Scalar, int row>
     static const Eigen::Array<_Scalar, row, 1> one_eigen_array = Eigen::Array<_Scalar, row, 1>::Constant(1);
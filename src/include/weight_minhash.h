@@ -7,31 +7,229 @@
 
 #include "lsh_cpp.h"
 #include "util.h"
+#include "hash.h"
+#include "counter_random.h"
 
 namespace LSH_CPP {
+    namespace detail {
+        template<typename T>
+        struct is_small_bitset : std::false_type {};
+
+        template<size_t N>
+        struct is_small_bitset<std::bitset<N>> : std::bool_constant<(N <= 64)> {};
+
+        /**
+         * counter-based 稀疏模式的元素编号. sketch 要在不同进程/编译器之间可以比较, 所以不能用实现定义的 std::hash:
+         *   整数和不超过 64 位的 bitset (DNA_Shingling 的 2-bit 编码) 直接用数值本身, 和 StreamingWeightMinHash 的编号一致;
+         *   字符串 / string_view / K_shingling 用 hash.h 中的 xxhash;
+         *   其他类型用 phmap::Hash (不带随机因子).
+         */
+        template<typename T>
+        inline uint64_t stable_element_id(const T &value) {
+            if constexpr (std::is_integral_v<T>) {
+                return static_cast<uint64_t>(value);
+            } else if constexpr (is_small_bitset<T>::value) {
+                return static_cast<uint64_t>(value.to_ullong());
+            } else if constexpr (std::is_invocable_r_v<uint64_t, xx_Hash<T> &, const T &>) {
+                return xx_Hash<T>{}(value);
+            } else {
+                return static_cast<uint64_t>(phmap::Hash<T>{}(value));
+            }
+        }
+
+        // 一个元素在所有采样上的 ICWS 参数, 每个数组长度为 sample_size (连续存储)
+        struct SampleParams {
+            const float *r, *ln_c, *beta;
+        };
+
+        // 按需生成采样参数时使用的栈上缓冲区
+        template<size_t sample_size>
+        struct SampleBuffer {
+            alignas(32) std::array<float, sample_size> r, ln_c, beta;
+        };
+
+        /**
+         * ICWS 的核心计算: 用一个非0元素 k (对数权重 log_w) 更新所有采样的 running argmin.
+         * 对每个采样 s:
+         *   t    = floor(log_w / r + beta)
+         *   ln_a = ln_c - (t - beta) * r - r
+         *   如果 ln_a < min_ln_a[s], 则记录 { k, t }
+         * r / ln_c / beta 是元素 k 在所有采样上的参数(连续存储), 有AVX2时一次处理8个采样.
+         * 运算顺序和原来 Eigen 的实现完全相同 (真正的除法, 不用 FMA): 预先算好 1/r 再做乘法会改变 floor 的取整边界,
+         * 少量 t 会差 1, 还要多存一个 dim * sample_size 的参数矩阵, 所以保留除法.
+         * 项目用 -Ofast -mfma 编译, 编译器默认会把乘加合并成 FMA 并重排减法 (AVX2 intrinsic 也一样),
+         * 所以这个函数单独关闭 fp-contract 和 fast-math, 保证 AVX2 路径和标量路径逐位相同 (见 test_icws_kernel).
+         * 元素按下标递增的顺序调用, 用严格小于比较, 所以相等时保留下标小的元素, 和 minCoeff 一致.
+         *
+         * 元素编号不是 32 位下标时 (比如 StreamingWeightMinHash 的 64 位元素编号), best_k 传 nullptr,
+         * 并传入 winners: 这个元素成为新最小值的采样编号按递增顺序写入 winners, 返回它们的个数, 调用方自己记录元素编号.
+         * winners 为 nullptr 时返回 0.
+         */
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off", "no-fast-math")
+#endif
+        template<size_t sample_size>
+        inline size_t icws_update_element(float log_w, uint32_t k,
+                                          const float *r, const float *ln_c, const float *beta,
+                                          float *min_ln_a, float *best_t, uint32_t *best_k,
+                                          uint32_t *winners = nullptr) {
+#ifdef __clang__
+#pragma clang fp contract(off) reassociate(off)
+#endif
+            size_t n_winners = 0;
+#ifdef __AVX2__
+            constexpr size_t simd_size = sample_size / 8 * 8;
+            const __m256 log_w_v = _mm256_set1_ps(log_w);
+            const __m256i k_v = _mm256_set1_epi32(static_cast<int>(k));
+            for (size_t s = 0; s < simd_size; s += 8) {
+                __m256 r_v = _mm256_loadu_ps(r + s);
+                __m256 beta_v = _mm256_loadu_ps(beta + s);
+                __m256 t_v = _mm256_floor_ps(_mm256_add_ps(_mm256_div_ps(log_w_v, r_v), beta_v));
+                // ln_a = (ln_c - (t - beta) * r) - r
+                __m256 ln_a_v = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(ln_c + s),
+                                                            _mm256_mul_ps(_mm256_sub_ps(t_v, beta_v), r_v)), r_v);
+                __m256 min_v = _mm256_loadu_ps(min_ln_a + s);
+                __m256 mask = _mm256_cmp_ps(ln_a_v, min_v, _CMP_LT_OQ);
+                _mm256_storeu_ps(min_ln_a + s, _mm256_blendv_ps(min_v, ln_a_v, mask));
+                _mm256_storeu_ps(best_t + s, _mm256_blendv_ps(_mm256_loadu_ps(best_t + s), t_v, mask));
+                if (best_k != nullptr) {
+                    __m256i best_k_v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(best_k + s));
+                    best_k_v = _mm256_blendv_epi8(best_k_v, k_v, _mm256_castps_si256(mask));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(best_k + s), best_k_v);
+                }
+                if (winners != nullptr) {
+                    for (auto bits = static_cast<uint32_t>(_mm256_movemask_ps(mask)); bits != 0; bits &= bits - 1) {
+                        winners[n_winners++] = static_cast<uint32_t>(s) + static_cast<uint32_t>(__builtin_ctz(bits));
+                    }
+                }
+            }
+#else
+            constexpr size_t simd_size = 0;
+#endif
+            for (size_t s = simd_size; s < sample_size; s++) {
+                float t = std::floor(log_w / r[s] + beta[s]);
+                float ln_y = (t - beta[s]) * r[s];
+                float ln_a = ln_c[s] - ln_y - r[s];
+                if (ln_a < min_ln_a[s]) {
+                    min_ln_a[s] = ln_a;
+                    best_t[s] = t;
+                    if (best_k != nullptr) best_k[s] = k;
+                    if (winners != nullptr) winners[n_winners++] = static_cast<uint32_t>(s);
+                }
+            }
+            return n_winners;
+        }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+        // 所有采样的 running argmin { min ln_a, k*, t_k* }
+        template<size_t sample_size>
+        struct ICWSArgmin {
+            alignas(32) std::array<float, sample_size> min_ln_a;
+            alignas(32) std::array<float, sample_size> best_t;
+            alignas(32) std::array<uint32_t, sample_size> best_k;
+            bool empty = true;
+
+            ICWSArgmin() {
+                min_ln_a.fill(std::numeric_limits<float>::infinity());
+                best_t.fill(0);
+                best_k.fill(0);
+            }
+
+            void update(float log_w, uint32_t k, const SampleParams &params) {
+                empty = false;
+                icws_update_element<sample_size>(log_w, k, params.r, params.ln_c, params.beta,
+                                                 min_ln_a.data(), best_t.data(), best_k.data());
+            }
+        };
+    }
+
     template<size_t dim, size_t sample_size = 128, size_t seed = 1, typename RandomGenerator = std::mt19937_64>
     struct RandomSample {
         using SampleMatrixType = Eigen::ArrayXXf;// 注意Eigen的二维Array类型是ArrayXXf
         SampleMatrixType r_k, ln_c_k, beta_k;
 
-        // 注意二维Array的维度用 (dim,sample_size), 这样通过 r_k.col(i) 得到的就是一个 ArrayXf (列向量形式),
-        // 后面WeightMinHash::update()里就可以直接和其他列向量形式的ArrayXf做element-wise计算了.
-        // 如果用 (sample_size,dim),那么r_k.row(i)得到的就是行向量形式的 ArrayXf.transpose(),
-        // 直接和其他的ArrayXf计算会变成内积操作,导致结果不对.
-        explicit RandomSample() : r_k(SampleMatrixType(dim, sample_size)),
-                                  ln_c_k(SampleMatrixType(dim, sample_size)),
-                                  beta_k(SampleMatrixType(dim, sample_size)) {
+        // 二维Array的维度用 (sample_size,dim), Eigen默认列优先存储, 所以 col(i) 是第 i 个元素在所有采样上的参数,
+        // 并且这 sample_size 个参数在内存中是连续的. WeightMinHash::update() 对每个非0元素只需要顺序读取一列,
+        // 就可以同时更新所有采样, 方便按采样维度做SIMD向量化.
+        // 随机数的生成顺序和之前 (dim,sample_size) 的布局保持一致, 同一个 seed 得到的采样参数不变.
+        explicit RandomSample() : r_k(SampleMatrixType(sample_size, dim)),
+                                  ln_c_k(SampleMatrixType(sample_size, dim)),
+                                  beta_k(SampleMatrixType(sample_size, dim)) {
             RandomGenerator generator(seed);
             std::gamma_distribution<float> gamma_dis(2, 1); // Gamma(2,1)
             std::uniform_real_distribution<float> uniform_dis(0, 1); // uniform(0,1)
             for (size_t n_sample = 0; n_sample < sample_size; n_sample++) {
                 for (size_t i = 0; i < dim; i++) {
-                    r_k(i, n_sample) = gamma_dis(generator);               // r_k ~ Gamma(2,1)
-                    ln_c_k(i, n_sample) = std::log(gamma_dis(generator));  // ln_c_k ~ ln(Gamma(2,1))
-                    beta_k(i, n_sample) = uniform_dis(generator);
+                    r_k(n_sample, i) = gamma_dis(generator);               // r_k ~ Gamma(2,1)
+                    ln_c_k(n_sample, i) = std::log(gamma_dis(generator));  // ln_c_k ~ ln(Gamma(2,1))
+                    beta_k(n_sample, i) = uniform_dis(generator);
                 }
             }
         }
+
+        // 元素 k 的采样参数, 直接指向采样矩阵的第 k 列 (不使用 buffer)
+        detail::SampleParams params(size_t k, detail::SampleBuffer<sample_size> &) const {
+            auto offset = static_cast<long>(k * sample_size);
+            return {r_k.data() + offset, ln_c_k.data() + offset, beta_k.data() + offset};
+        }
+    };
+
+    /**
+     * counter-based 采样: 不保存任何采样矩阵, 每次 update 时由 Philox4x32(counter = {采样编号, 元素编号}, key = seed)
+     * 按需生成元素在所有采样上的参数. 一次 Philox 输出 128 bit, 切成 5 个 23-bit 的均匀分布 u1..u5 (开区间 (0,1), u1 * u2 < 1):
+     *   r_k    = -ln(u1 * u2)        ~ Gamma(2,1) (两个指数分布之和)
+     *   ln_c_k = ln(-ln(u3 * u4))    ~ ln(Gamma(2,1))
+     *   beta_k = u5                  ~ uniform(0,1)
+     * 元素编号可以是任意 64 位整数 (比如元素值的哈希), 所以稀疏实现也不需要全局的位置编码表,
+     * sketch 与插入顺序无关, 并且在不同进程之间可以复现. 启动时没有任何初始化开销.
+     * 生成的随机数序列和 std::mt19937_64 模式不同, 两种模式的 sketch 不能互相比较.
+     */
+    template<size_t dim, size_t sample_size, size_t seed>
+    struct RandomSample<dim, sample_size, seed, Philox4x32> {
+        detail::SampleParams params(uint64_t k, detail::SampleBuffer<sample_size> &buffer) const {
+            const auto k_low = static_cast<uint32_t>(k), k_high = static_cast<uint32_t>(k >> 32u);
+            constexpr auto key_low = static_cast<uint32_t>(seed), key_high = static_cast<uint32_t>(uint64_t(seed) >> 32u);
+            float *r = buffer.r.data(), *ln_c = buffer.ln_c.data(), *beta = buffer.beta.data();
+            // 第一步: Philox 生成均匀分布, 暂存 u1*u2 -> r, u3*u4 -> ln_c, u5 -> beta
+#ifdef __AVX2__
+            constexpr size_t simd_size = sample_size / 8 * 8;
+            for (size_t s = 0; s < simd_size; s += 8) {
+                __m256i c0 = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(s)),
+                                              _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+                __m256i c1 = _mm256_set1_epi32(static_cast<int>(k_low)), c2 = _mm256_set1_epi32(static_cast<int>(k_high));
+                __m256i c3 = _mm256_setzero_si256();
+                Philox4x32::generate(c0, c1, c2, c3, key_low, key_high);
+                const __m256i low_byte = _mm256_set1_epi32(0xFF);
+                __m256i u5_bits = _mm256_or_si256(_mm256_and_si256(c0, low_byte),
+                                                  _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(c1, low_byte), 8),
+                                                                  _mm256_slli_epi32(_mm256_and_si256(c2, low_byte), 16)));
+                _mm256_storeu_ps(r + s, _mm256_mul_ps(Philox4x32::uniform23(_mm256_srli_epi32(c0, 9)),
+                                                      Philox4x32::uniform23(_mm256_srli_epi32(c1, 9))));
+                _mm256_storeu_ps(ln_c + s, _mm256_mul_ps(Philox4x32::uniform23(_mm256_srli_epi32(c2, 9)),
+                                                         Philox4x32::uniform23(_mm256_srli_epi32(c3, 9))));
+                _mm256_storeu_ps(beta + s, Philox4x32::uniform23(u5_bits));
+            }
+#else
+            constexpr size_t simd_size = 0;
+#endif
+            for (size_t s = simd_size; s < sample_size; s++) {
+                uint32_t c0 = static_cast<uint32_t>(s), c1 = k_low, c2 = k_high, c3 = 0;
+                Philox4x32::generate(c0, c1, c2, c3, key_low, key_high);
+                r[s] = Philox4x32::uniform23(c0 >> 9u) * Philox4x32::uniform23(c1 >> 9u);
+                ln_c[s] = Philox4x32::uniform23(c2 >> 9u) * Philox4x32::uniform23(c3 >> 9u);
+                beta[s] = Philox4x32::uniform23((c0 & 0xFFu) | ((c1 & 0xFFu) << 8u) | ((c2 & 0xFFu) << 16u));
+            }
+            // 第二步: 变换为 Gamma(2,1) 等分布 (编译器用向量化的 log 实现)
+#pragma omp simd
+            for (size_t s = 0; s < sample_size; s++) {
+                r[s] = -std::log(r[s]);
+                ln_c[s] = std::log(-std::log(ln_c[s]));
+            }
+            return {r, ln_c, beta};
+        }
     };
 
     // WeightMinHash 模板类
@@ -71,39 +269,66 @@ namespace LSH_CPP {
             hash_values.resize(sample_size);
         }
 
-        // update by weight vector
-        // 注意Eigen计算时的 Aliasing.
-        // 见: https://eigen.tuxfamily.org/dox/group__TopicAliasing.html
-        // 另外要注意 ArrayXf 是列向量形式的,如果要做element-wise的计算就必须确保其他变量也是列向量形式,否则就会变成内积操作导致结果错误.
-        bool update(std::vector<WeightType> &weight_vector) {
-            assert(weight_vector.size() == dim);
-            // 外部权重类型可以是任意的数值类型比如 int/float/size_t, 但在预处理后统统转换为 ArrayXf w_v, 也就是float类型权重.
-            // 所以理论上权重的大小最多不能超过 float::max() 的范围.
-            Eigen::Map<Eigen::Array<WeightType, Eigen::Dynamic, 1>> temp(weight_vector.data(), weight_vector.size());
-            Eigen::ArrayXf w_v;
-            if ((temp == 0).all()) return false; // 如果数据全0,则update失败,返回false
-            if ((temp == 0).any()) { // 至少存在一个位置的权重为0,将其改为float的最小值.
-                // change zero value in weight_vector to numeric_limits<float>::min() = 1.17549e-38
-                // instead of nan (because Eigen process nan will be undefined).
-                // select function : C = (expression).select(A,B); => C = expression ?  A : B (element-wise)
-                w_v = (temp == 0).select(Eigen::ArrayXf::Constant(temp.size(), std::numeric_limits<float>::min()),
-                                         temp);
-            } else {
-                // 如果一个0都没有,直接把原数据cast为float的ArrayXf即可,即调用 Array.cast<other_type>().
-                // 但是因为这里temp的类型本身也是需要经过推导的,所以temp调用cast方法的时候需要加上template前缀.
-                w_v = temp.template cast<float>();
-            }
+    private:
+        // 对所有非0权重 { k, weight } 运行 ICWS. for_each_nonzero(f) 需要对每个非0元素调用一次 f(k, weight).
+        // 对数权重只计算一次, 每个元素取出它在所有采样上的参数(连续存储), 更新所有采样的 running argmin,
+        // 整个过程没有堆上的临时数组, 开销只和非0元素个数成正比.
+        template<typename ForEachNonZero>
+        bool update_nonzero(ForEachNonZero &&for_each_nonzero) {
+            detail::ICWSArgmin<sample_size> argmin;
+            detail::SampleBuffer<sample_size> buffer;
+            for_each_nonzero([&](size_t k, float weight) {
+                assert(k < dim);
+                argmin.update(std::log(weight), static_cast<uint32_t>(k), sample.params(k, buffer));
+            });
+            if (argmin.empty) return false; // 如果数据全0,则update失败,返回false
             for (size_t i = 0; i < sample_size; i++) {
-                Eigen::ArrayXf t_k = (w_v.log() / sample.r_k.col(i) + sample.beta_k.col(i)).floor();
-                Eigen::ArrayXf ln_y = (t_k - sample.beta_k.col(i)) * sample.r_k.col(i);
-                Eigen::ArrayXf ln_a = sample.ln_c_k.col(i) - ln_y - sample.r_k.col(i);
-                Eigen::ArrayXf::Index k_star, garbage; // ArrayXf 第二个下标默认是0,随便用某个变量获取即可
-                ln_a.minCoeff(&k_star, &garbage);      // 找到ln_a最小值的位置下标 (k*,0)
-                hash_values[i] = {static_cast<MinHashValueFirstType >(k_star),                 // k*
-                                  static_cast<MinHashValueSecondType >(t_k(k_star, 0))};   // t_k*
+                hash_values[i] = {static_cast<MinHashValueFirstType >(argmin.best_k[i]),     // k*
+                                  static_cast<MinHashValueSecondType >(argmin.best_t[i])};   // t_k*
             }
             return true;
         }
+
+    public:
+        // update by weight vector
+        // 权重为0的元素不属于集合, 本来就不应该被ICWS选中, 所以只遍历非0权重的位置.
+        // (原来的实现把0权重换成 float::min() 参与计算, 这样的元素 ln_a 约为 +87, 只有在非0权重都小于 1e-35 左右时
+        //  才可能被选中, 跳过它们以后只有这种极端输入的 sketch 会不同.)
+        // 外部权重类型可以是任意的数值类型比如 int/float/size_t, 但统统转换为float计算,
+        // 所以理论上权重的大小最多不能超过 float::max() 的范围.
+        bool update(const std::vector<WeightType> &weight_vector) {
+            assert(weight_vector.size() == dim);
+            return update_nonzero([&](auto &&f) {
+                for (size_t k = 0; k < dim; k++) {
+                    if (weight_vector[k] != 0) f(k, static_cast<float>(weight_vector[k]));
+                }
+            });
+        }
+
+        // update by sparse weight vector: { index, weight } 对, index 不能重复, 权重为0的项会被忽略.
+        // 比如 dna_kmer_code_count<k>() 的结果可以直接作为参数, k-mer 的 2-bit 编码就是下标.
+        // index 按递增顺序排列时, 结果和等价的稠密权重向量 update 完全一致.
+        template<typename Index, typename Weight,
+                typename = std::enable_if_t<std::is_integral_v<Index> && std::is_arithmetic_v<Weight>>>
+        bool update(const std::vector<std::pair<Index, Weight>> &sparse_weight_vector) {
+            return update_nonzero([&](auto &&f) {
+                for (const auto &[index, weight] : sparse_weight_vector) {
+                    if (weight != 0) f(static_cast<size_t>(index), static_cast<float>(weight));
+                }
+            });
+        }
+
+        // update by Eigen::SparseVector (非0元素按下标递增存储)
+        template<typename Scalar, int Options, typename StorageIndex>
+        bool update(const Eigen::SparseVector<Scalar, Options, StorageIndex> &sparse_weight_vector) {
+            assert(sparse_weight_vector.size() == static_cast<long>(dim));
+            return update_nonzero([&](auto &&f) {
+                for (typename Eigen::SparseVector<Scalar, Options, StorageIndex>::InnerIterator it(
+                        sparse_weight_vector); it; ++it) {
+                    if (it.value() != 0) f(static_cast<size_t>(it.index()), static_cast<float>(it.value()));
+                }
+            });
+        }
     };
 
     template<size_t dim, typename UpdateInterfaceElementType, size_t sample_size, size_t seed, typename RandomGenerator>
@@ -113,53 +338,116 @@ namespace LSH_CPP {
                     typename std::enable_if_t<std::is_arithmetic<UpdateInterfaceElementType>::value>>::sample{};
 
 
-    // 稀疏采样矩阵. 当权重向量位置编号从0逐渐增加时,逐行扩展采样矩阵的分布参数,而不是立刻构建完整的采样矩阵,否则内存开销过大,将无法运行程序.
-    template<size_t dim, size_t sample_size, size_t seed, typename RandomGenerator>
-    struct SparseSampleMatrix {
+    /**
+     * 稀疏 WeightMinHash 的共享上下文, 持有原来的模板静态全局状态:
+     *   1. 元素值 -> 权重向量位置编码 的映射表;
+     *   2. 按位置编码逐行扩展的采样矩阵 (每一行是一个元素在所有采样上的 r_k / ln_c_k / beta_k).
+     * 不同的语料库可以使用不同的 WeightedSketcher, 位置编码互不影响; 同一个 WeightedSketcher 可以被多个线程同时使用.
+     *
+     * 并发设计(读多写少: 语料中的元素大部分在前面已经出现过):
+     *   映射表分成 n_shards 个分片, 每个分片一个 std::shared_mutex, 查找已有元素只需要共享锁;
+     *   采样矩阵按 chunk_rows 行一块分配, 块一旦分配就不再移动, 所以已经发布的行可以无锁读取;
+     *   只有新元素需要独占锁: 在 growth_mutex 下分配位置编码、按顺序生成这一行的随机参数, 然后再插入映射表,
+     *   其他线程只能通过映射表拿到位置编码, 因此拿到编码时这一行一定已经写好了.
+     * 随机参数的生成顺序和原来的 SparseSampleMatrix 相同 (按位置编码逐行、每行按采样顺序生成).
+     *
+     * @tparam SetValueType 集合元素的实际值类型, 需要支持 std::hash
+     * @param max_elements 位置编码的上限 (即 dim)
+     */
+    template<typename SetValueType, size_t sample_size, size_t seed = 1, typename RandomGenerator = std::mt19937_64>
+    class WeightedSketcher {
+    public:
+        static constexpr size_t chunk_rows = 1024;
+        static constexpr size_t n_shards = 64;
+
+    private:
+        struct Chunk {
+            alignas(32) std::array<float, chunk_rows * sample_size> r_k, ln_c_k, beta_k;
+        };
+
+        struct Shard {
+            mutable std::shared_mutex mutex;
+            HashMap<SetValueType, size_t> pos_map;
+        };
+
+        size_t max_elements;
+        std::unique_ptr<std::atomic<Chunk *>[]> chunks; // 块目录, 大小固定, 所以读取时不需要加锁
+        std::array<Shard, n_shards> shards;
+
+        std::mutex growth_mutex;
         RandomGenerator generator;                           // 初始为generator(seed)
         std::uniform_real_distribution<float> uniform_dis;   // uniform dis ~ (0,1)
         std::gamma_distribution<float> gamma_dis;            // gamma dis ~ (2,1)
+        std::atomic<size_t> global_pos{0};                   // 全局位置编码,初始为0
 
-        // row: dynamic(最大可能达到dim,不过大多数场合达不到); col: 固定 sample_size 维度.
-        // 设计成这种维度的目的是: 非常容易将其转换为 Eigen::ArrayXf 和 Eigen::ArrayXXf, 只要通过 Eigen::Map 转换即可.
-        // 比如: 当我们知道当前的集合需要计算 0,2,7,12 这四个位置元素的weight_min_hash, 要将采样矩阵的参数拿出来聚合成 Dense ArrayXXf 以便于后面mkl加速.
-        // 只需要拿出 Matrix[0],Matrix[2],Matrix[7],Matrix[12] 这四个位置的std::array的data指针(调用data()方法),
-        // 再通过Eigen::Map直接映射为Eigen::ArrayXXf 即可,这个过程只需要耗费遍历集合元素的时间,而且不用多余的拷贝(直接拿原数据指针,快且节省空间).
-        using RowType = std::array<float, sample_size>;             // 矩阵每一行的类型
-        using Matrix = std::vector<RowType>;                        // 矩阵类型
-
-        Matrix r_k, ln_c_k, beta_k;                                 // 采样矩阵
-        static constexpr size_t init_reserve_number = 10000;        // 采样矩阵初始预留的10000行空间,避免push_back频繁alloc
-
-        explicit SparseSampleMatrix() : generator(seed), uniform_dis(0, 1), gamma_dis(2, 1) {
-            r_k.reserve(init_reserve_number);
-            ln_c_k.reserve(init_reserve_number);
-            beta_k.reserve(init_reserve_number);
-        }
+        [[nodiscard]] size_t n_chunks() const { return (max_elements + chunk_rows - 1) / chunk_rows; }
 
-        /**
-         * 单行扩展sample_matrix
-         */
-        void update_matrix() {
-            RowType r_k_temp, ln_c_k_temp, beta_k_temp;
+        Shard &shard_of(const SetValueType &value) { return shards[std::hash<SetValueType>{}(value) % n_shards]; }
+
+        // 在 growth_mutex 下调用: 分配下一个位置编码并生成这一行的采样参数
+        size_t append_row() {
+            size_t pos = global_pos.load(std::memory_order_relaxed);
+            if (pos >= max_elements) {
+                throw std::length_error("WeightedSketcher: number of distinct elements exceeds dim = " +
+                                        std::to_string(max_elements));
+            }
+            Chunk *chunk = chunks[pos / chunk_rows].load(std::memory_order_relaxed);
+            if (chunk == nullptr) {
+                chunk = new Chunk;
+                chunks[pos / chunk_rows].store(chunk, std::memory_order_release);
+            }
+            size_t offset = (pos % chunk_rows) * sample_size;
             for (size_t j = 0; j < sample_size; j++) {
-                r_k_temp[j] = gamma_dis(generator);                  // r_k ~ Gamma(2,1)
-                ln_c_k_temp[j] = std::log(gamma_dis(generator));     // ln_c_k ~ ln(Gamma(2,1))
-                beta_k_temp[j] = uniform_dis(generator);             // beta_k ~ uniform(0,1)
+                chunk->r_k[offset + j] = gamma_dis(generator);                  // r_k ~ Gamma(2,1)
+                chunk->ln_c_k[offset + j] = std::log(gamma_dis(generator));     // ln_c_k ~ ln(Gamma(2,1))
+                chunk->beta_k[offset + j] = uniform_dis(generator);             // beta_k ~ uniform(0,1)
             }
-            r_k.push_back(r_k_temp);
-            ln_c_k.push_back(ln_c_k_temp);
-            beta_k.push_back(beta_k_temp);
+            global_pos.store(pos + 1, std::memory_order_release);
+            return pos;
         }
 
-        /**
-         * @param expand_sample_matrix_rows 需要扩展的 sample_matrix 行数
-         */
-        void update_matrix(size_t sample_matrix_expand_rows) {
-            while (sample_matrix_expand_rows--) {
-                update_matrix();
+    public:
+        explicit WeightedSketcher(size_t max_elements) : max_elements(max_elements),
+                                                         chunks(new std::atomic<Chunk *>[n_chunks()]),
+                                                         generator(seed), uniform_dis(0, 1), gamma_dis(2, 1) {
+            for (size_t i = 0; i < n_chunks(); i++) chunks[i].store(nullptr, std::memory_order_relaxed);
+        }
+
+        WeightedSketcher(const WeightedSketcher &) = delete;
+
+        WeightedSketcher &operator=(const WeightedSketcher &) = delete;
+
+        ~WeightedSketcher() {
+            for (size_t i = 0; i < n_chunks(); i++) delete chunks[i].load(std::memory_order_relaxed);
+        }
+
+        // 元素值的位置编码, 第一次出现时分配新编码
+        size_t position(const SetValueType &value) {
+            auto &shard = shard_of(value);
+            {
+                std::shared_lock<std::shared_mutex> lock(shard.mutex);
+                if (auto it = shard.pos_map.find(value); it != shard.pos_map.end()) return (*it).second;
+            }
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            if (auto it = shard.pos_map.find(value); it != shard.pos_map.end()) return (*it).second; // 其他线程刚插入
+            size_t pos;
+            {
+                std::lock_guard<std::mutex> growth_lock(growth_mutex);
+                pos = append_row();
             }
+            shard.pos_map.try_emplace(value, pos);
+            return pos;
+        }
+
+        // 位置编码 pos 在所有采样上的参数 (pos 必须来自 position())
+        detail::SampleParams params(size_t pos) const {
+            const Chunk *chunk = chunks[pos / chunk_rows].load(std::memory_order_acquire);
+            size_t offset = (pos % chunk_rows) * sample_size;
+            return {chunk->r_k.data() + offset, chunk->ln_c_k.data() + offset, chunk->beta_k.data() + offset};
         }
+
+        // 已经分配的位置编码个数
+        [[nodiscard]] size_t size() const { return global_pos.load(std::memory_order_acquire); }
     };
 
     // TODO: WeightMinHash for sparse matrix/vector 的测试结果低于 dense sample matrix 的实现,
@@ -168,8 +456,10 @@ namespace LSH_CPP {
     //       对应的采样矩阵的值当然也不是集中的,所以可能随机效果更好.
     // WeightMinHash for sparse matrix/vector,用于大规模的实际文本数据
     // update 接收单一集合作为参数,内部生成权重向量:
-    // 其中权重向量的元素位置编码由内部全局哈希表决定(但需要集合元素类型提供接口value()获取集合元素的实际值,集合元素的实际值也可以是任意类型);
+    // 其中权重向量的元素位置编码由 WeightedSketcher 上下文决定(但需要集合元素类型提供接口value()获取集合元素的实际值,集合元素的实际值也可以是任意类型);
     // 权重值需要集合元素类型提供接口获取,权重值类型可以任意(比如整数的重复次数权重,tf-idf浮点权重等).
+    // 默认构造时使用全局默认上下文(与之前的静态全局状态行为相同); 也可以传入自己的 WeightedSketcher,
+    // 不同语料使用各自的位置编码空间, 同一个上下文可以在多个线程中同时 update.
     template<size_t dim, typename UpdateInterfaceElementType, size_t sample_size, size_t seed, typename RandomGenerator>
     struct WeightMinHash<dim, UpdateInterfaceElementType, sample_size, seed, RandomGenerator,
             typename std::enable_if_t<(dim > dim_gap_for_different_impl)>,
@@ -183,9 +473,17 @@ namespace LSH_CPP {
         using MinHashValueSecondType = int_fast32_t; // Type of t_k* (t_k* 计算过程中最后用了取整操作,所以t_k*是整型)
         using MinHashValueType = std::pair<MinHashValueFirstType, MinHashValueSecondType>; // 记录 k* , t_k*
 
-        static HashMap <SetValueType, size_t> global_weight_vector_pos_map; //　记录权重向量中每一个元素的位置编码.
-        static SparseSampleMatrix<dim, sample_size, seed, RandomGenerator> sample_matrix; // 静态全局采样矩阵
-        static size_t global_pos;                                                         // 全局位置编码,初始为0
+    public:
+        using Context = WeightedSketcher<SetValueType, sample_size, seed, RandomGenerator>;
+
+    private:
+        Context *context = nullptr;                                                        // nullptr 表示默认上下文
+        static constexpr RandomSample<dim, sample_size, seed, Philox4x32> counter_sample{};  // counter-based 模式的采样(无状态)
+
+        static Context &default_context() {
+            static Context context(dim); // C++11 起局部静态变量的初始化是线程安全的
+            return context;
+        }
 
     public:
         std::vector<MinHashValueType> hash_values;
@@ -195,69 +493,52 @@ namespace LSH_CPP {
             hash_values.resize(sample_size);
         }
 
+        explicit WeightMinHash(Context &context) : context(&context) {
+            hash_values.resize(sample_size);
+        }
+
         // update by single set
         // 注意 SetElementType 必须有 weight() 和 value() 两个 public 接口,否则编译会失败.
         void update(const HashSet <SetElementType> &set) {
-            Eigen::ArrayXf weight_vector(set.size()); // 权重向量中非0部分聚合成Dense Array(注意 ArrayXf 是列向量形式的).
-            Eigen::ArrayXXf r_k(set.size(), sample_size);
-            Eigen::ArrayXXf ln_c_k(set.size(), sample_size);
-            Eigen::ArrayXXf beta_k(set.size(), sample_size);
-            int row_index = 0;
-            std::pair<typename HashMap<SetValueType, size_t>::const_iterator, bool> ret;
-            for (const auto &element:set) {
-                // insert and return { const_iterator, bool }.
-                ret = global_weight_vector_pos_map.try_emplace(element.value(), global_pos);
-
-                // insert success and update global_pos && update one row of sample_matrix for this new element.
-                if (ret.second) {
-                    global_pos++;
-                    sample_matrix.update_matrix();
+            if constexpr (std::is_same_v<RandomGenerator, Philox4x32>) {
+                // counter-based 模式: 元素编号由 detail::stable_element_id 从元素值得到, 采样参数按需生成,
+                // 不需要位置编码表和采样矩阵(也就不使用上下文), sketch 与其他集合的插入顺序无关.
+                detail::ICWSArgmin<sample_size> argmin;
+                detail::SampleBuffer<sample_size> buffer;
+                std::vector<uint64_t> element_ids;
+                element_ids.reserve(set.size());
+                for (const auto &element : set) {
+                    if (element.weight() == 0) continue;
+                    uint64_t id = detail::stable_element_id(element.value());
+                    argmin.update(std::log(static_cast<float>(element.weight())),
+                                  static_cast<uint32_t>(element_ids.size()), counter_sample.params(id, buffer));
+                    element_ids.push_back(id);
+                }
+                if (argmin.empty) return;
+                for (size_t i = 0; i < sample_size; i++) {
+                    hash_values[i] = {static_cast<MinHashValueFirstType >(element_ids[argmin.best_k[i]]), // k*
+                                      static_cast<MinHashValueSecondType >(argmin.best_t[i])};           // t_k*
+                }
+            } else {
+                // 通过上下文得到每个元素的位置编码和这一行的采样参数, 然后和稠密实现一样做 running argmin.
+                // k* 记录的是元素的全局位置编码, 所以不同集合的 k* 可以直接比较.
+                Context &sketcher = context != nullptr ? *context : default_context();
+                detail::ICWSArgmin<sample_size> argmin;
+                for (const auto &element : set) {
+                    if (element.weight() == 0) continue;
+                    size_t pos = sketcher.position(element.value());
+                    argmin.update(std::log(static_cast<float>(element.weight())), static_cast<uint32_t>(pos),
+                                  sketcher.params(pos));
+                }
+                if (argmin.empty) return;
+                for (size_t i = 0; i < sample_size; i++) {
+                    hash_values[i] = {static_cast<MinHashValueFirstType >(argmin.best_k[i]),     // k*
+                                      static_cast<MinHashValueSecondType >(argmin.best_t[i])};   // t_k*
                 }
-
-                // 无论插入成不成功都可以通过 (*(ret.first)).second 直接获得当前元素element已存在的位置编码pos.
-                // 通过这个位置编码pos获取sample_matrix对应位置的参数,并聚合成 Dense ArrayXXf
-                // 注意: 这里不需要保证 ArrayXXf 的 r_k,ln_c_k,beta_k 从上到下是按照元素位置编码的顺序摆放的,
-                // 它只要保证与 weight_vector(列向量) 每一行对应的元素一致即可.
-                auto pos = (*(ret.first)).second;
-                r_k.row(row_index) = Eigen::Map<Eigen::ArrayXf>(sample_matrix.r_k[pos].data(), sample_size);
-                ln_c_k.row(row_index) = Eigen::Map<Eigen::ArrayXf>(sample_matrix.ln_c_k[pos].data(), sample_size);
-                beta_k.row(row_index) = Eigen::Map<Eigen::ArrayXf>(sample_matrix.beta_k[pos].data(), sample_size);
-
-                // 更新 weight_vector (只保留权重非0,即当前集合元素的部分)
-                weight_vector(row_index) = element.weight();
-
-                // 更新行号
-                row_index++;
-            }
-            // 剩下的部分就和 dim<=100000 的实现一样了,直接用 Eigen::ArrayXf 之间的 Element-wise 计算即可,从而利用eigen的dense数组优化.
-            for (long i = 0; i < static_cast<long>(sample_size); i++) {
-                Eigen::ArrayXf t_k = (weight_vector.log() / r_k.col(i) + beta_k.col(i)).floor();
-                Eigen::ArrayXf ln_y = (t_k - beta_k.col(i)) * r_k.col(i);
-                Eigen::ArrayXf ln_a = ln_c_k.col(i) - ln_y - r_k.col(i);
-                Eigen::ArrayXf::Index k_star, garbage; // ArrayXf 第二个下标默认是0,随便用某个变量获取即可
-                ln_a.minCoeff(&k_star, &garbage);      // 找到ln_a最小值的位置下标 (k*,0)
-                hash_values[i] = {static_cast<MinHashValueFirstType >(k_star),                 // k*
-                                  static_cast<MinHashValueSecondType >(t_k(k_star, 0))};   // t_k*
             }
         }
     };
 
-    template<size_t dim, typename T, size_t sample_size, size_t seed, typename RandomGenerator>
-    HashMap<typename T::ValueType, size_t> WeightMinHash<dim, T, sample_size, seed, RandomGenerator,
-            typename std::enable_if_t<(dim > dim_gap_for_different_impl)>,
-            typename std::enable_if_t<std::is_arithmetic<typename T::WeightType>::value>>::global_weight_vector_pos_map{};
-
-    template<size_t dim, typename T, size_t sample_size, size_t seed, typename RandomGenerator>
-    SparseSampleMatrix<dim, sample_size, seed, RandomGenerator>
-            WeightMinHash<dim, T, sample_size, seed, RandomGenerator,
-                    typename std::enable_if_t<(dim > dim_gap_for_different_impl)>,
-                    typename std::enable_if_t<std::is_arithmetic<typename T::WeightType>::value>>::sample_matrix{};
-
-    template<size_t dim, typename T, size_t sample_size, size_t seed, typename RandomGenerator>
-    size_t WeightMinHash<dim, T, sample_size, seed, RandomGenerator,
-            typename std::enable_if_t<(dim > dim_gap_for_different_impl)>,
-            typename std::enable_if_t<std::is_arithmetic<typename T::WeightType>::value>>::global_pos = 0;
-
     // 计算 weight_minhash 的 jaccard_similarity
     template<size_t dim, typename T, size_t sample_size, size_t seed, typename RG>
     double weight_minhash_jaccard(const WeightMinHash<dim, T, sample_size, seed, RG, void, void> &A,
@@ -272,6 +553,79 @@ namespace LSH_CPP {
         return count / (double) (sample_size);
     }
 
+    namespace detail {
+        // murmur3 的 64-bit finalizer, 把 (k*, t_k*) 混合成均匀分布的指纹
+        inline uint64_t fmix64(uint64_t x) {
+            x ^= x >> 33u;
+            x *= 0xFF51AFD7ED558CCDull;
+            x ^= x >> 33u;
+            x *= 0xC4CEB9FE1A85EC53ull;
+            x ^= x >> 33u;
+            return x;
+        }
+
+        // 统计两个数组中相同位置上相等的元素个数, 有AVX2时一次比较 32 字节
+        template<typename T>
+        inline size_t count_equal(const T *a, const T *b, size_t n) {
+            static_assert(std::is_same_v<T, uint32_t> || std::is_same_v<T, uint64_t>);
+            size_t count = 0, i = 0;
+#ifdef __AVX2__
+            constexpr size_t lanes = 32 / sizeof(T);
+            for (; i + lanes <= n; i += lanes) {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+                __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+                __m256i eq;
+                if constexpr (sizeof(T) == 8) eq = _mm256_cmpeq_epi64(x, y); else eq = _mm256_cmpeq_epi32(x, y);
+                // 每个相等的 lane 贡献 sizeof(T) 个为1的字节掩码位
+                count += static_cast<size_t>(__builtin_popcount(static_cast<uint32_t>(_mm256_movemask_epi8(eq))))
+                         / sizeof(T);
+            }
+#endif
+            for (; i < n; i++) count += (a[i] == b[i]);
+            return count;
+        }
+    }
+
+    /**
+     * WeightMinHash 的紧凑表示: 每个采样的 (k*, t_k*) 哈希成一个 32/64 位指纹.
+     * 原来的 std::pair<size_t, int_fast32_t> 每个采样 16 字节, uint64_t 指纹只要 8 字节, uint32_t 指纹只要 4 字节.
+     * 两个不同的 (k*, t_k*) 指纹碰撞的概率是 2^-64 / 2^-32, 对 jaccard 估计的影响可以忽略.
+     * uint64_t 指纹的 hash_values 和 MinHash 的 hash_values 类型相同, 可以直接交给 LSH 做 band 哈希.
+     */
+    template<size_t sample_size, typename FingerprintType = uint64_t>
+    struct PackedWeightMinHash {
+        static_assert(std::is_same_v<FingerprintType, uint32_t> || std::is_same_v<FingerprintType, uint64_t>,
+                      "PackedWeightMinHash fingerprint must be uint32_t or uint64_t.");
+
+        std::vector<FingerprintType> hash_values;
+
+        explicit PackedWeightMinHash() : hash_values(sample_size, 0) {}
+
+        // 由 (k*, t_k*) 序列构造, 比如 WeightMinHash / StreamingWeightMinHash 的 hash_values
+        explicit PackedWeightMinHash(const std::vector<std::pair<size_t, int_fast32_t>> &weight_hash_values) {
+            assert(weight_hash_values.size() == sample_size);
+            hash_values.resize(sample_size);
+            for (size_t i = 0; i < sample_size; i++) {
+                const auto &[k_star, t_k_star] = weight_hash_values[i];
+                uint64_t fingerprint = detail::fmix64(static_cast<uint64_t>(k_star) ^ detail::fmix64(
+                        static_cast<uint64_t>(static_cast<uint32_t>(t_k_star)) + 0x9E3779B97F4A7C15ull));
+                hash_values[i] = static_cast<FingerprintType>(fingerprint);
+            }
+        }
+
+        template<size_t dim, typename T, size_t seed, typename RG>
+        explicit PackedWeightMinHash(const WeightMinHash<dim, T, sample_size, seed, RG, void, void> &weight_minhash)
+                : PackedWeightMinHash(weight_minhash.hash_values) {}
+    };
+
+    // 计算 packed weight_minhash 的 jaccard_similarity (SIMD 比较指纹)
+    template<size_t sample_size, typename FingerprintType>
+    double weight_minhash_jaccard(const PackedWeightMinHash<sample_size, FingerprintType> &A,
+                                  const PackedWeightMinHash<sample_size, FingerprintType> &B) {
+        return (double) detail::count_equal(A.hash_values.data(), B.hash_values.data(), sample_size) /
+               (double) (sample_size);
+    }
+
     // 计算带权重集实际的 jaccard_similarity, 需要预先提供权重向量
     // 参考: https://en.wikipedia.org/wiki/Jaccard_index#Generalized_Jaccard_similarity_and_distance
     // 例子: A = { a, a, a, b, b, c } B = { a, a, b, b, b, d }
@@ -293,6 +647,28 @@ namespace LSH_CPP {
         return min_ / max_;
     }
 
+    // 计算稀疏权重向量 { index, weight } (按 index 递增排序, 比如 dna_kmer_code_count 的结果) 的 jaccard_similarity,
+    // 和稠密权重向量的计算方法相同, 只是用归并的方式遍历两个向量的非0部分.
+    template<typename Index, typename WeightType,
+            typename = std::enable_if_t<std::is_integral_v<Index> && std::is_arithmetic_v<WeightType>>>
+    double generalized_jaccard_similarity(const std::vector<std::pair<Index, WeightType>> &A,
+                                          const std::vector<std::pair<Index, WeightType>> &B) {
+        double min_ = 0, max_ = 0;
+        size_t i = 0, j = 0;
+        while (i < A.size() || j < B.size()) {
+            if (j == B.size() || (i < A.size() && A[i].first < B[j].first)) {
+                max_ += A[i++].second;
+            } else if (i == A.size() || B[j].first < A[i].first) {
+                max_ += B[j++].second;
+            } else {
+                min_ += std::min(A[i].second, B[j].second);
+                max_ += std::max(A[i].second, B[j].second);
+                i++, j++;
+            }
+        }
+        return min_ / max_;
+    }
+
     // 计算带权重集实际的 jaccard_similarity, 不需要提供权重向量, 直接提供两个集合即可, 计算方法如下:
     // 如果 A 与 B 均不存在的元素位置,必然权重都是0,那么 min(0,0) = max(0,0) = 0, 所以这一部分直接省略;
     // 对于 A存在,B不存在 或者 B存在,A不存在的部分,min必然是0,忽略,而max就是对应存在部分的权重值;
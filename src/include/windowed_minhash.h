@@ -0,0 +1,110 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_WINDOWED_MINHASH_H
+#define LSH_CPP_WINDOWED_MINHASH_H
+
+#include "lsh_cpp.h"
+#include "k_shingles.h"
+#include "minhash.h"
+
+namespace LSH_CPP {
+    // 窗口 sketch 在 LSH 中的 label: 第 doc 条序列中起始位置为 offset 的窗口
+    struct WindowLabel {
+        uint32_t doc;
+        uint32_t offset;
+
+        bool operator==(const WindowLabel &other) const { return doc == other.doc && offset == other.offset; }
+    };
+
+    /**
+     * 长序列的滑动窗口 MinHash: 窗口长度 window, 步长 stride, 对每个窗口 [offset, offset + window) 计算 MinHash,
+     * 结果和对窗口子串单独计算 MinHash (split_dna_shingling) 完全相同, 可以用 WindowLabel 插入 LSH 查找序列之间的局部相似区域.
+     * 整条序列的 MinHash 中, 一小段同源区域对 jaccard 的贡献几乎可以忽略, 窗口 sketch 则保留了这些局部信息.
+     *
+     * 增量计算: 每个 permutation (slot) 维护一个单调队列 { 哈希值, k-mer 位置 }, 哈希值递增.
+     * 新 k-mer 从队尾进入 (弹出所有哈希值不小于它的元素, 它们在之后的窗口中不可能再成为最小值),
+     * 输出窗口时从队首弹出已经移出窗口的 k-mer, 队首就是这个 slot 在当前窗口中的最小值.
+     * 每个 k-mer 在每个 slot 中最多进出队列各一次, 总计算量和对整条序列计算一次 MinHash 相同 O(N * n_permutation),
+     * 而每个窗口单独计算需要 O(N * window / stride * n_permutation). 随机哈希值的单调队列期望长度只有 O(log window).
+     *
+     * 序列短于 window 时只输出一个覆盖整条序列的窗口; 序列尾部不足一个步长的部分不单独输出窗口.
+     * 含有非 ACGT 字符的 k-mer 会被跳过 (与 dna_kmer_code_count 相同).
+     * MinHashType 的哈希函数需要接受 DNA_Shingling<k, WeightFlag::no_weight> (比如 StdDNAShinglingHash64<k>).
+     */
+    template<size_t k, typename MinHashType>
+    class WindowedMinHash {
+        static_assert(k > 0 && k <= 32, "k-mer 2-bit code must fit in uint64_t.");
+    private:
+        size_t window;
+        size_t stride;
+
+    public:
+        WindowedMinHash(size_t window, size_t stride) : window(window), stride(stride) {
+            if (window < k || stride == 0) {
+                throw std::invalid_argument("WindowedMinHash: needs window >= k (" + std::to_string(k) +
+                                            ") and stride > 0, got window " + std::to_string(window) + " stride " +
+                                            std::to_string(stride));
+            }
+        }
+
+        // 计算所有窗口的 { 窗口起始位置, MinHash }, 按起始位置递增排序
+        std::vector<std::pair<size_t, MinHashType>> sketch(const std::string_view &sequence) const {
+            using ShinglingType = DNA_Shingling<k, WeightFlag::no_weight>;
+            constexpr uint64_t mask = (k == 32) ? ~uint64_t(0) : ((uint64_t(1) << (2 * k)) - 1);
+            std::vector<std::pair<size_t, MinHashType>> result;
+            if (sequence.empty()) return result;
+            const size_t length = std::min(window, sequence.size());
+            const size_t n_windows = (sequence.size() - length) / stride + 1;
+            result.reserve(n_windows);
+
+            MinHashType hasher;
+            const size_t n_permutation = hasher.length();
+            std::vector<uint64_t> values(n_permutation);
+            std::vector<std::deque<std::pair<uint64_t, size_t>>> queues(n_permutation);
+            uint64_t code = 0;
+            size_t valid = 0, next_window = 0;
+            for (size_t i = 0; i < sequence.size() && next_window < n_windows; i++) {
+                int base = dna_base_code(sequence[i]);
+                if (base < 0) {
+                    valid = 0;
+                } else {
+                    code = ((code << 2u) | static_cast<uint64_t>(base)) & mask;
+                    if (++valid >= k) {
+                        const size_t position = i + 1 - k;
+                        hasher.element_hash_values(ShinglingType{typename ShinglingType::ValueType(code)},
+                                                   values.data());
+                        for (size_t slot = 0; slot < n_permutation; slot++) {
+                            auto &queue = queues[slot];
+                            while (!queue.empty() && queue.back().first >= values[slot]) queue.pop_back();
+                            queue.emplace_back(values[slot], position);
+                        }
+                    }
+                }
+                // 窗口 [offset, offset + length) 的最后一个碱基已经处理完, 输出这个窗口
+                const size_t offset = next_window * stride;
+                if (i + 1 == offset + length) {
+                    MinHashType window_sketch;
+                    for (size_t slot = 0; slot < n_permutation; slot++) {
+                        auto &queue = queues[slot];
+                        while (!queue.empty() && queue.front().second < offset) queue.pop_front();
+                        if (!queue.empty()) window_sketch.hash_values[slot] = queue.front().first;
+                    }
+                    result.emplace_back(offset, std::move(window_sketch));
+                    next_window++;
+                }
+            }
+            return result;
+        }
+    };
+}
+namespace std {
+    template<>
+    struct hash<LSH_CPP::WindowLabel> {
+        std::size_t operator()(LSH_CPP::WindowLabel const &label) const {
+            return phmap::HashState::combine(0, (static_cast<uint64_t>(label.doc) << 32u) | label.offset);
+        }
+    };
+}
+#endif //LSH_CPP_WINDOWED_MINHASH_H
@@ -0,0 +1,33 @@
+//
+// Created by junior on 2026/10/18.
+//
+#include <csignal>
+#include "query_server.h"
+
+namespace {
+    LSH_CPP::Server::QueryServer<> *server_instance = nullptr;
+
+    void handle_signal(int) {
+        if (server_instance != nullptr) server_instance->stop();
+    }
+}
+
+// usage: ./lsh_cpp_server [socket_path] [fastq_path]
+int main(int argc, char *argv[]) {
+    using namespace LSH_CPP;
+    const std::string socket_path = argc > 1 ? argv[1] : Server::CONFIG::socket_path;
+    const std::string data_path = argc > 2 ? argv[2] : Server::CONFIG::sra_dna_data_path;
+
+    Server::QueryServer<> server;
+    TimeVar start = timeNow();
+    server.load(get_document_from_fastq_file(data_path.c_str()));
+    std::cout << "load " << server.size() << " reads : " << second_duration(timeNow() - start) << " seconds\n";
+
+    server_instance = &server;
+    std::signal(SIGINT, handle_signal);
+    std::signal(SIGTERM, handle_signal);
+    std::cout << "listen on " << socket_path << " ...\n";
+    if (!server.run(socket_path)) return -1;
+    server.print_stats();
+    return 0;
+}
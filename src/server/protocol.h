@@ -0,0 +1,166 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_SERVER_PROTOCOL_H
+#define LSH_CPP_SERVER_PROTOCOL_H
+
+#include "../include/lsh_cpp.h"
+
+// POSIX socket include
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+namespace LSH_CPP::Server {
+    /**
+     * 本机 Unix domain socket 上的二进制协议. 客户端和服务端一定在同一台机器上,所以直接使用主机字节序.
+     *
+     * Request frame:
+     *   uint32_t length        后面所有字段的字节数 (不含 length 自身)
+     *   uint64_t request_id    客户端自定义,服务端原样返回,用于在同一个连接上区分请求
+     *   uint8_t  type          RequestType
+     *   payload                QuerySequence: DNA 序列原始字节; QuerySketch: n_permutation 个 uint64_t 最小哈希值
+     *
+     * Response frame:
+     *   uint32_t length
+     *   uint64_t request_id
+     *   uint8_t  status        ResponseStatus
+     *   uint32_t n_results
+     *   n_results * { uint64_t id, float score }   候选 read 编号和 minhash jaccard 相似度
+     */
+    enum class RequestType : uint8_t {
+        QuerySequence = 1,
+        QuerySketch = 2,
+    };
+
+    enum class ResponseStatus : uint8_t {
+        Ok = 0,
+        BadRequest = 1,
+    };
+
+    struct QueryResult {
+        uint64_t id;
+        float score;
+    };
+
+    constexpr size_t request_header_size = sizeof(uint64_t) + sizeof(uint8_t);
+    constexpr size_t response_header_size = sizeof(uint64_t) + sizeof(uint8_t) + sizeof(uint32_t);
+    constexpr uint32_t max_frame_size = 64u << 20u; // 单个 frame 最大 64MB,超过就认为对端出错
+
+    // 读满 n 个字节. 对端关闭或出错时返回 false.
+    inline bool read_full(int fd, void *buffer, size_t n) {
+        auto *p = static_cast<char *>(buffer);
+        while (n > 0) {
+            ssize_t ret = ::read(fd, p, n);
+            if (ret < 0 && errno == EINTR) continue;
+            if (ret <= 0) return false;
+            p += ret;
+            n -= static_cast<size_t>(ret);
+        }
+        return true;
+    }
+
+    // 写满 n 个字节. 使用 send(MSG_NOSIGNAL) 避免对端关闭时进程收到 SIGPIPE.
+    inline bool write_full(int fd, const void *buffer, size_t n) {
+        const auto *p = static_cast<const char *>(buffer);
+        while (n > 0) {
+            ssize_t ret = ::send(fd, p, n, MSG_NOSIGNAL);
+            if (ret < 0 && errno == EINTR) continue;
+            if (ret <= 0) return false;
+            p += ret;
+            n -= static_cast<size_t>(ret);
+        }
+        return true;
+    }
+
+    // 读取一个完整 frame (不含 length 字段) 到 frame 中.
+    inline bool read_frame(int fd, std::vector<char> &frame) {
+        uint32_t length;
+        if (!read_full(fd, &length, sizeof(length)) || length > max_frame_size) return false;
+        frame.resize(length);
+        return read_full(fd, frame.data(), length);
+    }
+
+    // 按顺序把 POD 字段追加到 buffer
+    template<typename T>
+    inline void append_pod(std::vector<char> &buffer, const T &value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const auto *p = reinterpret_cast<const char *>(&value);
+        buffer.insert(buffer.end(), p, p + sizeof(T));
+    }
+
+    template<typename T>
+    inline T read_pod(const char *data) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        return value;
+    }
+
+    inline std::vector<char> make_request(uint64_t request_id, RequestType type, const void *payload, size_t size) {
+        std::vector<char> buffer;
+        buffer.reserve(sizeof(uint32_t) + request_header_size + size);
+        append_pod(buffer, static_cast<uint32_t>(request_header_size + size));
+        append_pod(buffer, request_id);
+        append_pod(buffer, static_cast<uint8_t>(type));
+        const auto *p = static_cast<const char *>(payload);
+        buffer.insert(buffer.end(), p, p + size);
+        return buffer;
+    }
+
+    inline std::vector<char> make_response(uint64_t request_id, ResponseStatus status,
+                                           const std::vector<QueryResult> &results) {
+        std::vector<char> buffer;
+        buffer.reserve(sizeof(uint32_t) + response_header_size + results.size() * sizeof(QueryResult));
+        append_pod(buffer, static_cast<uint32_t>(response_header_size +
+                                                 results.size() * (sizeof(uint64_t) + sizeof(float))));
+        append_pod(buffer, request_id);
+        append_pod(buffer, static_cast<uint8_t>(status));
+        append_pod(buffer, static_cast<uint32_t>(results.size()));
+        for (const auto &result : results) {
+            append_pod(buffer, result.id);
+            append_pod(buffer, result.score);
+        }
+        return buffer;
+    }
+
+    // 解析 response frame (不含 length 字段)
+    inline bool parse_response(const std::vector<char> &frame, uint64_t &request_id, ResponseStatus &status,
+                               std::vector<QueryResult> &results) {
+        if (frame.size() < response_header_size) return false;
+        request_id = read_pod<uint64_t>(frame.data());
+        status = static_cast<ResponseStatus>(read_pod<uint8_t>(frame.data() + sizeof(uint64_t)));
+        auto n_results = read_pod<uint32_t>(frame.data() + sizeof(uint64_t) + sizeof(uint8_t));
+        constexpr size_t result_size = sizeof(uint64_t) + sizeof(float);
+        if (frame.size() != response_header_size + n_results * result_size) return false;
+        results.resize(n_results);
+        const char *p = frame.data() + response_header_size;
+        for (size_t i = 0; i < n_results; i++, p += result_size) {
+            results[i] = {read_pod<uint64_t>(p), read_pod<float>(p + sizeof(uint64_t))};
+        }
+        return true;
+    }
+
+    inline sockaddr_un make_unix_address(const std::string &path) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        return address;
+    }
+
+    // 连接服务端,失败返回 -1
+    inline int connect_unix_socket(const std::string &path) {
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        sockaddr_un address = make_unix_address(path);
+        if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}
+#endif //LSH_CPP_SERVER_PROTOCOL_H
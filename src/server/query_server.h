@@ -0,0 +1,253 @@
+//
+// Created by junior on 2026/10/18.
+//
+
+#ifndef LSH_CPP_QUERY_SERVER_H
+#define LSH_CPP_QUERY_SERVER_H
+
+#include "../include/lsh_cpp.h"
+#include "../include/util.h"
+#include "../include/io.h"
+#include "../include/time_def.h"
+#include "../include/k_shingles.h"
+#include "../include/hash.h"
+#include "../include/minhash.h"
+#include "../include/lsh.h"
+#include "protocol.h"
+
+namespace LSH_CPP::Server {
+    namespace CONFIG {
+        // 与 dna_benchmark 的配置保持一致
+        constexpr size_t k = 6;
+        constexpr size_t n_sample = 512;
+        const double threshold = 0.7;
+        const std::pair<double, double> weights = {0.1, 0.9};
+
+        const char *socket_path = "/tmp/lsh_cpp.sock";
+        const char *sra_dna_data_path = "../../dna-data/sra_data.fastq";
+
+        // 批处理参数: 一个 batch 最多 max_batch_size 个请求; 队列里第一个请求最多等待 max_batch_delay 就开始处理.
+        constexpr size_t max_batch_size = 64;
+        constexpr std::chrono::microseconds max_batch_delay{200};
+    }
+
+    /**
+     * 本地查询服务. 启动时一次性加载 reads, 计算 MinHash sketch 并建立 LSH 索引,
+     * 之后通过 Unix domain socket 接收查询请求 (协议见 protocol.h).
+     * 线程模型:
+     *   accept 线程(run() 的调用者) -> 每个连接一个读线程, 解析 frame 后放入请求队列;
+     *   一个 batch 线程从队列里合并请求, 用 OpenMP 并行计算整个 batch, 然后把结果写回各自的连接.
+     * 并发连接越多, batch 越满, 单个请求分摊的调度开销越小.
+     */
+    template<size_t k = CONFIG::k, size_t n_sample = CONFIG::n_sample>
+    class QueryServer {
+    public:
+        using MinHashType = MinHash<StdDNAShinglingHash64<k>, 32, n_sample>;
+        using LSH_Type = LSH<XXUInt64Hash64, size_t, 0, 0, n_sample>;
+
+    private:
+        struct Connection {
+            int fd;
+            std::mutex write_mutex; // 同一个连接的 response 可能来自不同 batch, 写入需要串行
+
+            explicit Connection(int fd) : fd(fd) {}
+
+            ~Connection() { ::close(fd); }
+
+            bool write(const std::vector<char> &buffer) {
+                std::lock_guard<std::mutex> lock(write_mutex);
+                return write_full(fd, buffer.data(), buffer.size());
+            }
+        };
+
+        struct Request {
+            std::shared_ptr<Connection> connection;
+            uint64_t request_id;
+            RequestType type;
+            std::vector<char> payload;
+        };
+
+        double threshold;
+        LSH_Type lsh;
+        std::vector<MinHashType> minhash_set; // sketch store, 下标就是 read 的编号
+
+        int listen_fd = -1;
+        std::atomic<bool> running{false};
+
+        std::mutex queue_mutex;
+        std::condition_variable queue_cv;
+        std::deque<Request> queue;
+
+        // 连接线程是 detach 的, 只记录还活着的连接个数 (退出时等待归零) 和连接本身 (退出时关闭读端).
+        // 每次 accept 时清理已经释放的连接, 所以长时间运行时不会积累已经断开的连接.
+        std::mutex connection_mutex;
+        std::condition_variable connection_cv;
+        std::vector<std::weak_ptr<Connection>> connections;
+        size_t n_live_connections = 0;
+
+        std::atomic<size_t> n_batches{0}, n_requests{0};
+
+        void connection_loop(std::shared_ptr<Connection> connection) {
+            std::vector<char> frame;
+            while (running.load(std::memory_order_relaxed) && read_frame(connection->fd, frame)) {
+                if (frame.size() < request_header_size) break;
+                Request request{connection,
+                                read_pod<uint64_t>(frame.data()),
+                                static_cast<RequestType>(read_pod<uint8_t>(frame.data() + sizeof(uint64_t))),
+                                std::vector<char>(frame.begin() + request_header_size, frame.end())};
+                {
+                    std::lock_guard<std::mutex> lock(queue_mutex);
+                    queue.push_back(std::move(request));
+                }
+                queue_cv.notify_one();
+            }
+            // 在持有锁的时候通知: run() 只有在这里释放锁以后才能返回, 之后线程不会再访问 this
+            std::lock_guard<std::mutex> lock(connection_mutex);
+            n_live_connections--;
+            connection_cv.notify_all();
+        }
+
+        // 从队列中取出一个 batch. 队列为空时阻塞; 不足 max_batch_size 时最多再等待 max_batch_delay.
+        bool pop_batch(std::vector<Request> &batch) {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [&]() { return !queue.empty() || !running.load(); });
+            if (queue.empty()) return false;
+            queue_cv.wait_for(lock, CONFIG::max_batch_delay,
+                              [&]() { return queue.size() >= CONFIG::max_batch_size || !running.load(); });
+            size_t n = std::min(queue.size(), CONFIG::max_batch_size);
+            batch.clear();
+            std::move(queue.begin(), queue.begin() + static_cast<long>(n), std::back_inserter(batch));
+            queue.erase(queue.begin(), queue.begin() + static_cast<long>(n));
+            return true;
+        }
+
+        std::vector<char> process(const Request &request) {
+            MinHashType min_hash;
+            if (request.type == RequestType::QuerySequence) {
+                std::string_view sequence(request.payload.data(), request.payload.size());
+                if (sequence.empty()) return make_response(request.request_id, ResponseStatus::BadRequest, {});
+                min_hash.update(split_dna_shingling<k, WeightFlag::no_weight>(sequence));
+            } else if (request.type == RequestType::QuerySketch &&
+                       request.payload.size() == n_sample * sizeof(uint64_t)) {
+                std::memcpy(min_hash.hash_values.data(), request.payload.data(), request.payload.size());
+            } else {
+                return make_response(request.request_id, ResponseStatus::BadRequest, {});
+            }
+            std::vector<QueryResult> results;
+            for (const auto &candidate : lsh.query(min_hash)) { // candidate set 过滤
+                auto sim = minhash_jaccard_similarity(min_hash, minhash_set[candidate]);
+                if (sim >= threshold) results.push_back({candidate, static_cast<float>(sim)});
+            }
+            std::sort(results.begin(), results.end(),
+                      [](const auto &a, const auto &b) { return a.score > b.score; });
+            return make_response(request.request_id, ResponseStatus::Ok, results);
+        }
+
+        void batch_loop() {
+            std::vector<Request> batch;
+            std::vector<std::vector<char>> responses;
+            while (pop_batch(batch)) {
+                responses.resize(batch.size());
+#pragma omp parallel for schedule(dynamic)
+                for (size_t i = 0; i < batch.size(); i++) {
+                    responses[i] = process(batch[i]);
+                }
+                for (size_t i = 0; i < batch.size(); i++) {
+                    batch[i].connection->write(responses[i]);
+                }
+                n_batches++;
+                n_requests += batch.size();
+            }
+        }
+
+    public:
+        explicit QueryServer(double threshold = CONFIG::threshold,
+                             std::pair<double, double> weights = CONFIG::weights)
+                : threshold(threshold), lsh(threshold, weights) {}
+
+        /**
+         * 加载 reads: 并行计算 sketch (MinHash 的 lru_cache 是分片加锁的共享缓存, 可以并行 update), 然后建立 LSH 索引.
+         */
+        void load(const std::vector<std::string> &data) {
+            minhash_set.resize(data.size());
+#pragma omp parallel for schedule(dynamic, 64)
+            for (size_t i = 0; i < data.size(); i++) {
+                minhash_set[i].update(split_dna_shingling<k, WeightFlag::no_weight>(data[i]));
+            }
+            for (size_t i = 0; i < minhash_set.size(); i++) {
+                lsh.insert(minhash_set[i], i);
+            }
+        }
+
+        [[nodiscard]] size_t size() const { return minhash_set.size(); }
+
+        /**
+         * 监听 socket_path 并阻塞处理请求, 直到 stop() 被调用.
+         */
+        bool run(const std::string &socket_path) {
+            listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listen_fd < 0) {
+                fprintf(stderr, "create socket fail: %s\n", std::strerror(errno));
+                return false;
+            }
+            ::unlink(socket_path.c_str());
+            sockaddr_un address = make_unix_address(socket_path);
+            if (::bind(listen_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+                ::listen(listen_fd, SOMAXCONN) < 0) {
+                fprintf(stderr, "bind %s fail: %s\n", socket_path.c_str(), std::strerror(errno));
+                ::close(listen_fd);
+                return false;
+            }
+            running = true;
+            std::thread batch_thread(&QueryServer::batch_loop, this);
+            while (running.load()) {
+                int fd = ::accept(listen_fd, nullptr, nullptr);
+                if (fd < 0) {
+                    if (errno == EINTR && running.load()) continue;
+                    break;
+                }
+                auto connection = std::make_shared<Connection>(fd);
+                std::lock_guard<std::mutex> lock(connection_mutex);
+                connections.erase(std::remove_if(connections.begin(), connections.end(),
+                                                 [](const auto &weak_connection) { return weak_connection.expired(); }),
+                                  connections.end());
+                connections.push_back(connection);
+                n_live_connections++;
+                std::thread(&QueryServer::connection_loop, this, std::move(connection)).detach();
+            }
+            running = false;
+            queue_cv.notify_all();
+            {
+                // 关闭所有连接的读端, 唤醒阻塞在 read 上的连接线程, 然后等待它们全部退出
+                std::unique_lock<std::mutex> lock(connection_mutex);
+                for (auto &weak_connection : connections) {
+                    if (auto connection = weak_connection.lock()) ::shutdown(connection->fd, SHUT_RD);
+                }
+                connection_cv.wait(lock, [&]() { return n_live_connections == 0; });
+                connections.clear();
+            }
+            batch_thread.join();
+            ::close(listen_fd);
+            ::unlink(socket_path.c_str());
+            return true;
+        }
+
+        /**
+         * 停止服务. 只包含 async-signal-safe 的操作, 可以在信号处理函数里调用.
+         */
+        void stop() {
+            running.store(false);
+            if (listen_fd >= 0) ::shutdown(listen_fd, SHUT_RDWR);
+        }
+
+        void print_stats() const {
+            std::cout << "===============  Server stats  ===============\n";
+            std::cout << "requests : " << n_requests.load() << "  batches : " << n_batches.load();
+            if (n_batches.load() > 0) {
+                std::cout << "  mean batch size : " << (double) n_requests.load() / (double) n_batches.load();
+            }
+            std::cout << "\n";
+        }
+    };
+}
+#endif //LSH_CPP_QUERY_SERVER_H
@@ -14,7 +14,25 @@
 #include "../include/minhash.h"
 #include "../include/lsh.h"
 #include "../include/weight_minhash.h"
+#include "../include/streaming_weight_minhash.h"
+#include "../include/prob_minhash.h"
+#include "../include/lsh_cosine_similarity.h"
+#include "../include/hamming_index.h"
+#include "../include/kmer_natural_vector.h"
+#include "../include/hyperloglog.h"
+#include "../include/super_minhash.h"
+#include "../include/bottom_k.h"
+#include "../include/multi_k_minhash.h"
+#include "../include/minimizer.h"
+#include "../include/windowed_minhash.h"
+#include "../include/hyper_minhash.h"
+#include "../include/sketch_io.h"
 #include "../include/lru_cache.h"
+#include "../include/lsh_handle.h"
+#include "../include/lsh_external.h"
+#include "../include/lsh_sharded.h"
+#include "../server/query_server.h"
+#include "../client/load_generator.h"
 
 namespace LSH_CPP::Test {
     using RANDOM_NUMBER_TYPE = uint64_t;
@@ -286,6 +304,1388 @@ namespace LSH_CPP::Test {
         std::cout << (*itr).second.value() << "\n";
     }
 
+    /**
+     * LSHHandle 压力测试: 多个读线程持续查询的同时, 写线程在后台不断重建索引并发布.
+     * 第 g 代索引里 doc_i 的 label 是 g * label_base + i, 所以一次查询得到的所有 label 必须属于同一代,
+     * 否则说明读到了不一致的快照. 最后检查所有旧索引都被回收.
+     */
+    void test_lsh_hot_swap() {
+        std::cout << "============ Test LSH hot swap. =============\n";
+        using MinHashType = MinHash<XXUInt64Hash64, 32, 128>;
+        using LSH_Type = LSH<XXUInt64Hash64, size_t, 32, 4, 128>;
+        constexpr size_t n_docs = 200, n_readers = 4, n_generations = 50, label_base = 1000;
+        std::mt19937_64 generator(42);
+        std::uniform_int_distribution<uint64_t> dis;
+        std::vector<MinHashType> minhash_set(n_docs);
+        for (auto &minhash : minhash_set) {
+            HashSet<uint64_t> doc;
+            for (size_t i = 0; i < 50; i++) doc.insert(dis(generator));
+            minhash.update(doc);
+        }
+        auto build = [&](size_t generation) {
+            auto lsh = std::make_unique<LSH_Type>();
+            for (size_t i = 0; i < n_docs; i++) lsh->insert(minhash_set[i], generation * label_base + i);
+            return lsh;
+        };
+
+        LSHHandle<LSH_Type> handle(build(0));
+        std::atomic<bool> stop{false};
+        std::atomic<size_t> inconsistent{0}, missing{0}, queries{0};
+        std::vector<std::vector<double>> latencies(n_readers);
+        std::vector<std::thread> readers;
+        for (size_t t = 0; t < n_readers; t++) {
+            readers.emplace_back([&, t]() {
+                auto reader = handle.register_reader();
+                size_t doc = t;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    doc = (doc + 1) % n_docs;
+                    TimeVar start = timeNow();
+                    HashSet<size_t> ret;
+                    {
+                        auto snapshot = reader->acquire();
+                        ret = snapshot->query(minhash_set[doc]);
+                    }
+                    latencies[t].push_back(millisecond_duration(timeNow() - start));
+                    queries++;
+                    if (ret.empty()) {
+                        missing++;
+                        continue;
+                    }
+                    size_t generation = (*ret.begin()) / label_base;
+                    bool self_found = false;
+                    for (const auto &label : ret) {
+                        if (label / label_base != generation) inconsistent++;
+                        if (label % label_base == doc) self_found = true;
+                    }
+                    if (!self_found) missing++;
+                }
+            });
+        }
+        for (size_t generation = 1; generation <= n_generations; generation++) {
+            handle.rebuild_async([&, generation]() { return build(generation); }).wait();
+        }
+        stop = true;
+        for (auto &reader : readers) reader.join();
+        handle.synchronize();
+
+        std::vector<double> all_latencies;
+        for (const auto &item : latencies) all_latencies.insert(all_latencies.end(), item.begin(), item.end());
+        std::cout << "publish version : " << handle.version() << "\n";
+        std::cout << "queries : " << queries << " inconsistent : " << inconsistent << " missing : " << missing << "\n";
+        std::cout << "retired (should be 0) : " << handle.retired_size() << "\n";
+        std::cout << "query latency mean : " << Statistic::get_mean(all_latencies) << " ms, 99% percentile : "
+                  << Statistic::get_percentile(all_latencies, 0.99, 0.001) << " ms\n";
+    }
+
+    void test_query_server() {
+        std::cout << "============ Test query server. =============\n";
+        constexpr size_t k = 6, n_sample = 128, n_groups = 100, group_size = 5;
+        using ServerType = Server::QueryServer<k, n_sample>;
+        // 每组 5 条 read 是同一条随机序列分别突变 2 个碱基, 组内相似度高, 组间几乎不相似
+        std::mt19937_64 generator(27);
+        std::uniform_int_distribution<size_t> base(0, 3), position(0, 149);
+        std::vector<std::string> reads;
+        for (size_t g = 0; g < n_groups; g++) {
+            std::string origin;
+            for (size_t i = 0; i < 150; i++) origin += "ATCG"[base(generator)];
+            for (size_t j = 0; j < group_size; j++) {
+                std::string read = origin;
+                for (size_t m = 0; m < 2; m++) read[position(generator)] = "ATCG"[base(generator)];
+                reads.push_back(read);
+            }
+        }
+        ServerType server(0.5, {0.1, 0.9});
+        server.load(reads);
+        const std::string socket_path = "/tmp/lsh_cpp_test_" + std::to_string(::getpid()) + ".sock";
+        std::thread server_thread([&]() { server.run(socket_path); });
+        int fd = -1;
+        for (size_t retry = 0; retry < 2000 && fd < 0; retry++) {
+            fd = Server::connect_unix_socket(socket_path);
+            if (fd < 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        // 同一个连接上依次发送 序列查询 / sketch 查询 / 错误请求, 检查 request_id, 状态和结果
+        auto round_trip = [&](uint64_t id, Server::RequestType type, const void *payload, size_t size,
+                              Server::ResponseStatus &status, std::vector<Server::QueryResult> &results) {
+            auto request = Server::make_request(id, type, payload, size);
+            std::vector<char> frame;
+            uint64_t response_id = 0;
+            return Server::write_full(fd, request.data(), request.size()) && Server::read_frame(fd, frame) &&
+                   Server::parse_response(frame, response_id, status, results) && response_id == id;
+        };
+        size_t n_wrong = 0, n_self_found = 0;
+        for (size_t i = 0; i < reads.size() && fd >= 0; i += 7) {
+            typename ServerType::MinHashType sketch;
+            sketch.update(split_dna_shingling<k, WeightFlag::no_weight>(reads[i]));
+            Server::ResponseStatus sequence_status, sketch_status;
+            std::vector<Server::QueryResult> sequence_results, sketch_results;
+            if (!round_trip(2 * i, Server::RequestType::QuerySequence, reads[i].data(), reads[i].size(),
+                            sequence_status, sequence_results) ||
+                !round_trip(2 * i + 1, Server::RequestType::QuerySketch, sketch.hash_values.data(),
+                            n_sample * sizeof(uint64_t), sketch_status, sketch_results) ||
+                sequence_status != Server::ResponseStatus::Ok || sketch_status != Server::ResponseStatus::Ok ||
+                sequence_results.size() != sketch_results.size()) {
+                n_wrong++;
+                continue;
+            }
+            for (size_t j = 0; j < sequence_results.size(); j++) {
+                const auto &result = sequence_results[j];
+                n_self_found += (result.id == i && result.score == 1.0f);
+                // 服务端的结果和本地计算的 jaccard 一致, 并且都在同一组内
+                typename ServerType::MinHashType expect;
+                expect.update(split_dna_shingling<k, WeightFlag::no_weight>(reads[result.id]));
+                n_wrong += result.id != sketch_results[j].id || result.id / group_size != i / group_size ||
+                           result.score != static_cast<float>(minhash_jaccard_similarity(sketch, expect));
+            }
+        }
+        Server::ResponseStatus bad_status = Server::ResponseStatus::Ok;
+        std::vector<Server::QueryResult> bad_results;
+        bool bad_request = fd >= 0 && round_trip(1u << 20u, Server::RequestType::QuerySketch, "AC", 2, bad_status,
+                                                 bad_results) && bad_status == Server::ResponseStatus::BadRequest;
+        if (fd >= 0) ::close(fd);
+        // 多个连接并发压测, batch 线程合并请求, 不应该有错误
+        auto report = Client::run_load(socket_path, reads, 4, 100);
+        server.stop();
+        server_thread.join();
+        std::cout << std::boolalpha << "connected : " << (fd >= 0) << "  self found : " << n_self_found << " / "
+                  << (reads.size() + 6) / 7 << "  wrong : " << n_wrong << "  bad request : " << bad_request
+                  << "  load requests : " << report.n_requests << "  load errors : " << report.n_errors << "\n";
+    }
+
+    void test_compressed_posting_list() {
+        std::cout << "============ Test compressed posting list. =============\n";
+        // 1. 基本读写: 大致递增(带少量乱序)的 label, 遍历顺序必须和插入顺序一致
+        CompressedPostingList<size_t> list;
+        std::vector<size_t> inserted;
+        std::mt19937_64 generator(1);
+        std::uniform_int_distribution<size_t> noise(0, 20);
+        bool round_trip = true;
+        for (size_t i = 0; i < 1000; i++) {
+            size_t label = i * 10 + noise(generator);
+            list.push_back(label);
+            inserted.push_back(label);
+            if (i < 40) { // 覆盖 inline 存储到堆存储的切换, 以及拷贝/移动
+                CompressedPostingList<size_t> copy = list;
+                CompressedPostingList<size_t> moved = std::move(copy);
+                moved.shrink_to_fit();
+                round_trip &= std::vector<size_t>(moved.begin(), moved.end()) == inserted;
+            }
+        }
+        list.shrink_to_fit();
+        round_trip &= std::vector<size_t>(list.begin(), list.end()) == inserted && list.size() == inserted.size();
+        CompressedPostingList<size_t> empty_list;
+        CompressedPostingList<int> signed_list{5, -3, 7, -1000000, 0};
+        round_trip &= std::vector<int>(signed_list.begin(), signed_list.end()) == std::vector<int>{5, -3, 7, -1000000, 0};
+        std::cout << std::boolalpha << "round trip : " << round_trip
+                  << "  empty : " << (empty_list.begin() == empty_list.end())
+                  << "  bytes per label : " << (double) list.heap_bytes() / (double) list.size() << "\n";
+
+        // 2. LSH 使用压缩 bucket 的查询结果必须和 std::vector bucket 完全一致.
+        // 簇的大小取真实数据中常见的偏斜分布: 一半的文档没有近似重复, 其余文档按 "富者更富" 加入已有的簇,
+        // 所以绝大多数 bucket 只有一两个 label, 少数 bucket 很大.
+        using MinHashType = MinHash<XXUInt64Hash64, 32, 128>;
+        using LSH_Type = LSH<XXUInt64Hash64, size_t, 32, 4, 128>;
+        using CompressedLSH_Type = LSH<XXUInt64Hash64, size_t, 32, 4, 128, CompressedPostingList<size_t>>;
+        constexpr size_t n_docs = 5000;
+        std::uniform_int_distribution<uint64_t> dis;
+        std::vector<HashSet<uint64_t>> centers;
+        std::vector<size_t> doc_center(n_docs);
+        std::vector<MinHashType> minhash_set(n_docs);
+        LSH_Type lsh;
+        CompressedLSH_Type compressed_lsh;
+        for (size_t i = 0; i < n_docs; i++) {
+            if (i == 0 || dis(generator) % 2 == 0) {
+                centers.emplace_back();
+                for (size_t j = 0; j < 100; j++) centers.back().insert(dis(generator));
+                doc_center[i] = centers.size() - 1;
+            } else {
+                doc_center[i] = doc_center[dis(generator) % i]; // 按簇的大小成比例地选择已有的簇
+            }
+            HashSet<uint64_t> doc;
+            for (const auto &item : centers[doc_center[i]]) {
+                if (dis(generator) % 10 != 0) doc.insert(item); // 保留 90% 的元素
+            }
+            minhash_set[i].update(doc);
+            lsh.insert(minhash_set[i], i);
+            compressed_lsh.insert(minhash_set[i], i);
+        }
+        lsh.shrink_to_fit();
+        compressed_lsh.shrink_to_fit();
+        size_t mismatch = 0;
+        for (const auto &minhash : minhash_set) {
+            if (lsh.query(minhash) != compressed_lsh.query(minhash)) mismatch++;
+        }
+        std::cout << "clusters : " << centers.size() << "  query mismatch : " << mismatch << "\n";
+        std::cout << "vector bucket memory : " << lsh.memory_usage() << " bytes, compressed bucket memory : "
+                  << compressed_lsh.memory_usage() << " bytes, ratio : "
+                  << (double) lsh.memory_usage() / (double) compressed_lsh.memory_usage() << "\n";
+        // 压缩比受每个 key 的平均 label 数限制: 每个 entry 固定 32 字节, 压缩只能减少 label 的 8 字节
+        auto expected_ratio = [](double labels_per_key) { return (32 + 8 * labels_per_key) / (32 + labels_per_key); };
+        double labels_per_key = (double) lsh.label_size() / (double) lsh.key_size();
+        std::cout << "labels per key : " << labels_per_key << "  expected ratio : " << expected_ratio(labels_per_key)
+                  << "\n";
+
+        // 3. 只有 10 个簇时 bucket 很大 (N/K 在几十以上), 整个表的压缩比才能达到 3x 以上
+        LSH_Type large_lsh;
+        CompressedLSH_Type large_compressed_lsh;
+        std::vector<HashSet<uint64_t>> large_centers(10);
+        for (auto &center : large_centers) {
+            for (size_t j = 0; j < 100; j++) center.insert(dis(generator));
+        }
+        for (size_t i = 0; i < n_docs; i++) {
+            HashSet<uint64_t> doc;
+            for (const auto &item : large_centers[i % large_centers.size()]) {
+                if (dis(generator) % 10 != 0) doc.insert(item); // 保留 90% 的元素
+            }
+            MinHashType minhash;
+            minhash.update(doc);
+            large_lsh.insert(minhash, i);
+            large_compressed_lsh.insert(minhash, i);
+        }
+        large_lsh.shrink_to_fit();
+        large_compressed_lsh.shrink_to_fit();
+        double large_ratio = (double) large_lsh.memory_usage() / (double) large_compressed_lsh.memory_usage();
+        labels_per_key = (double) large_lsh.label_size() / (double) large_lsh.key_size();
+        std::cout << "large buckets : labels per key : " << labels_per_key << "  expected ratio : "
+                  << expected_ratio(labels_per_key) << "  ratio : " << large_ratio << "\n";
+    }
+
+    void test_external_lsh() {
+        std::cout << "============ Test external LSH. =============\n";
+        // 内存预算很小, 强制频繁溢写和归并; 查询结果必须和纯内存 LSH 完全一致
+        using MinHashType = MinHash<XXUInt64Hash64, 32, 128>;
+        using LSH_Type = LSH<XXUInt64Hash64, size_t, 32, 4, 128>;
+        using ExternalLSH_Type = ExternalLSH<XXUInt64Hash64, size_t, 32, 4, 128>;
+        constexpr size_t n_clusters = 10, n_docs = 5000;
+        std::mt19937_64 generator(2);
+        std::uniform_int_distribution<uint64_t> dis;
+        std::vector<HashSet<uint64_t>> centers(n_clusters);
+        for (auto &center : centers) {
+            for (size_t i = 0; i < 100; i++) center.insert(dis(generator));
+        }
+        auto directory = std::filesystem::temp_directory_path() / ("lsh_cpp_external_" + std::to_string(::getpid()));
+        std::vector<MinHashType> minhash_set(n_docs);
+        LSH_Type lsh;
+        size_t mismatch = 0;
+        {
+            // 两个索引共用同一个目录, 溢写节奏完全相同但 label 不同 (other_lsh 的 label 加上 n_docs), run 文件不能互相覆盖
+            ExternalLSH_Type external_lsh(directory.string(), 4096, 4);
+            ExternalLSH_Type other_lsh(directory.string(), 4096, 4);
+            auto other_query = [&](const MinHashType &minhash) {
+                HashSet<size_t> result;
+                for (const auto &label : other_lsh.query(minhash)) result.insert(label - n_docs);
+                return result;
+            };
+            for (size_t i = 0; i < n_docs; i++) {
+                HashSet<uint64_t> doc;
+                for (const auto &item : centers[i % n_clusters]) {
+                    if (dis(generator) % 10 != 0) doc.insert(item); // 保留 90% 的元素
+                }
+                minhash_set[i].update(doc);
+                lsh.insert(minhash_set[i], i);
+                external_lsh.insert(minhash_set[i], i);
+                other_lsh.insert(minhash_set[i], n_docs + i);
+            }
+            external_lsh.print_config();
+            for (const auto &minhash : minhash_set) {
+                if (lsh.query(minhash) != external_lsh.query(minhash)) mismatch++;
+                if (lsh.query(minhash) != other_query(minhash)) mismatch++;
+            }
+            external_lsh.flush();
+            other_lsh.flush();
+            for (const auto &minhash : minhash_set) {
+                if (lsh.query(minhash) != external_lsh.query(minhash)) mismatch++;
+                if (lsh.query(minhash) != other_query(minhash)) mismatch++;
+            }
+            external_lsh.print_config();
+        }
+        std::cout << "query mismatch : " << mismatch << "  run files left : "
+                  << std::distance(std::filesystem::directory_iterator(directory),
+                                   std::filesystem::directory_iterator{}) << "\n";
+
+        // 每次溢写只有 512 / 32 = 16 条记录, 每个 band 溢写约 312 次. 每次都全部归并的话写放大约为 312 / 4 / 2 ≈ 39,
+        // size-tiered 归并的写放大不超过 1 + ceil(log_4(312)) = 6, 每个 band 的 run 数不超过 3 * 层数
+        {
+            constexpr size_t fan_in = 4;
+            ExternalLSH_Type external_lsh(directory.string(), 512, fan_in);
+            for (size_t i = 0; i < n_docs; i++) external_lsh.insert(minhash_set[i], i);
+            size_t tiered_mismatch = 0;
+            for (const auto &minhash : minhash_set) {
+                if (lsh.query(minhash) != external_lsh.query(minhash)) tiered_mismatch++;
+            }
+            double spills = (double) (n_docs * 32) / (512.0 / 32);
+            double bound = 1 + std::ceil(std::log(spills / 32) / std::log((double) fan_in));
+            external_lsh.print_config();
+            std::cout << std::boolalpha << "tiered mismatch : " << tiered_mismatch
+                      << "  write amplification within bound (" << bound << ") : "
+                      << (external_lsh.write_amplification() <= bound)
+                      << "  runs per band within bound : " << (external_lsh.run_size() <= 32 * (fan_in - 1) * bound)
+                      << "\n";
+        }
+
+        // 目录被删除以后溢写失败: 抛出 std::system_error 而不是退出进程, 已经插入的数据不丢失, 目录恢复以后可以继续溢写
+        bool error_reported = false;
+        size_t recovered_mismatch = 0;
+        {
+            ExternalLSH_Type external_lsh(directory.string(), 1u << 20u, 4);
+            for (size_t i = 0; i < n_docs; i++) external_lsh.insert(minhash_set[i], i);
+            std::filesystem::remove_all(directory);
+            try {
+                external_lsh.flush();
+            } catch (const std::system_error &e) {
+                error_reported = e.code() == std::errc::no_such_file_or_directory;
+            }
+            std::filesystem::create_directories(directory);
+            external_lsh.flush();
+            for (const auto &minhash : minhash_set) {
+                if (lsh.query(minhash) != external_lsh.query(minhash)) recovered_mismatch++;
+            }
+        }
+        std::cout << std::boolalpha << "io error reported : " << error_reported
+                  << "  mismatch after recovery : " << recovered_mismatch << "\n";
+        std::filesystem::remove_all(directory);
+    }
+
+    void test_sharded_lsh() {
+        std::cout << "============ Test sharded LSH. =============\n";
+        // 4 个 worker 进程的分片 LSH, 单条查询和批量查询的结果都必须和单进程 LSH 完全一致
+        using MinHashType = MinHash<XXUInt64Hash64, 32, 128>;
+        using LSH_Type = LSH<XXUInt64Hash64, size_t, 32, 4, 128>;
+        using ShardedLSH_Type = ShardedLSH<XXUInt64Hash64, size_t, 32, 4, 128>;
+        constexpr size_t n_clusters = 10, n_docs = 5000, n_shards = 4;
+        // 创建时另一个线程正在分配内存 (持有 malloc 的锁), worker 进程仍然要能正常工作
+        std::atomic<bool> stop_allocating{false};
+        std::thread allocator([&stop_allocating]() {
+            std::deque<std::vector<uint64_t>> buffers;
+            while (!stop_allocating.load(std::memory_order_relaxed)) {
+                buffers.emplace_back(1024);
+                if (buffers.size() > 64) buffers.pop_front();
+            }
+        });
+        ShardedLSH_Type sharded_lsh(n_shards);
+        stop_allocating = true;
+        allocator.join();
+        std::mt19937_64 generator(3);
+        std::uniform_int_distribution<uint64_t> dis;
+        std::vector<HashSet<uint64_t>> centers(n_clusters);
+        for (auto &center : centers) {
+            for (size_t i = 0; i < 100; i++) center.insert(dis(generator));
+        }
+        std::vector<MinHashType> minhash_set(n_docs);
+        LSH_Type lsh;
+        for (size_t i = 0; i < n_docs; i++) {
+            HashSet<uint64_t> doc;
+            for (const auto &item : centers[i % n_clusters]) {
+                if (dis(generator) % 10 != 0) doc.insert(item); // 保留 90% 的元素
+            }
+            minhash_set[i].update(doc);
+            lsh.insert(minhash_set[i], i);
+            sharded_lsh.insert(minhash_set[i], i);
+        }
+        size_t mismatch = 0;
+        for (size_t i = 0; i < 100; i++) {
+            if (lsh.query(minhash_set[i]) != sharded_lsh.query(minhash_set[i])) mismatch++;
+        }
+        auto candidate_sets = sharded_lsh.query(minhash_set);
+        for (size_t i = 0; i < n_docs; i++) {
+            if (lsh.query(minhash_set[i]) != candidate_sets[i]) mismatch++;
+        }
+        std::cout << "query mismatch : " << mismatch << "\n";
+        sharded_lsh.print_config();
+    }
+
+    void test_icws_kernel() {
+        std::cout << "============ Test ICWS kernel simd / scalar. =============\n";
+        // sample_size = 15: 采样 0~7 走 AVX2 路径, 8~14 走标量尾部. 采样 s 和 s + 8 (s < 7) 使用相同的参数,
+        // 两条路径的结果必须逐位相同 (不能被编译器合并成 FMA)
+        constexpr size_t sample_size = 15, n_elements = 20000;
+        std::mt19937_64 generator(31);
+        std::gamma_distribution<float> gamma(2, 1);
+        std::uniform_real_distribution<float> uniform(0, 1), log_weight(-3, 8);
+        std::array<float, sample_size> r{}, ln_c{}, beta{}, min_ln_a{}, best_t{};
+        std::array<uint32_t, sample_size> best_k{};
+        min_ln_a.fill(std::numeric_limits<float>::infinity());
+        size_t mismatch = 0;
+        for (uint32_t k = 0; k < n_elements; k++) {
+            for (size_t s = 0; s < 8; s++) {
+                r[s] = gamma(generator);
+                ln_c[s] = std::log(gamma(generator));
+                beta[s] = uniform(generator);
+                if (s < 7) r[s + 8] = r[s], ln_c[s + 8] = ln_c[s], beta[s + 8] = beta[s];
+            }
+            // 每次都从 +inf 开始, 比较这一个元素在两条路径上算出的 ln_a 和 t
+            min_ln_a.fill(std::numeric_limits<float>::infinity());
+            detail::icws_update_element<sample_size>(log_weight(generator), k, r.data(), ln_c.data(), beta.data(),
+                                                     min_ln_a.data(), best_t.data(), best_k.data());
+            for (size_t s = 0; s < 7; s++) {
+                mismatch += (min_ln_a[s] != min_ln_a[s + 8] || best_t[s] != best_t[s + 8]);
+            }
+        }
+        std::cout << "simd / scalar mismatch : " << mismatch << " / " << n_elements * 7 << "\n";
+    }
+
+    void test_weight_minhash_sparse_update() {
+        std::cout << "============ Test weight minhash sparse update. =============\n";
+        // 稀疏输入 ({ k-mer 编码, 个数 } / Eigen::SparseVector) 和稠密权重向量的 sketch 必须完全一致
+        constexpr size_t k = 6, dim = 4096, n_sample = 512;
+        using weight_minhash_t = WeightMinHash<dim, uint32_t, n_sample>;
+        std::mt19937_64 generator(4);
+        std::uniform_int_distribution<size_t> base(0, 3);
+        size_t code_mismatch = 0, sketch_mismatch = 0;
+        for (size_t n = 0; n < 100; n++) {
+            std::string read;
+            for (size_t i = 0; i < 150; i++) read += "ATCG"[base(generator)];
+            std::vector<uint32_t> dense(dim);
+            for (const auto &item : split_dna_shingling<k, WeightFlag::has_weight>(read)) {
+                dense[item.value().to_ulong()] = item.weight();
+            }
+            auto sparse = dna_kmer_code_count<k>(read);
+            Eigen::SparseVector<float> eigen_sparse(dim);
+            for (const auto &[code, count] : sparse) {
+                if (dense[code] != count) code_mismatch++;
+                eigen_sparse.insert(static_cast<long>(code)) = static_cast<float>(count);
+            }
+            if (std::accumulate(dense.begin(), dense.end(), size_t(0)) != 150 - k + 1) code_mismatch++;
+            weight_minhash_t A, B, C;
+            A.update(dense);
+            B.update(sparse);
+            C.update(eigen_sparse);
+            if (A.hash_values != B.hash_values || A.hash_values != C.hash_values) sketch_mismatch++;
+        }
+        std::cout << "code mismatch : " << code_mismatch << "  sketch mismatch : " << sketch_mismatch << "\n";
+    }
+
+    void test_weight_minhash_counter_sample() {
+        std::cout << "============ Test weight minhash counter-based sample. =============\n";
+        // counter-based(Philox4x32) 采样和预生成采样矩阵的估计误差应该相当
+        constexpr size_t dim = 4096, n_sample = 256, n_pairs = 200;
+        using sparse_weight_vector_t = std::vector<std::pair<uint32_t, uint32_t>>;
+        std::mt19937_64 generator(5);
+        std::uniform_int_distribution<uint32_t> index_dis(0, dim - 1), weight_dis(1, 5), noise(0, 3);
+        double error = 0, counter_error = 0;
+        for (size_t n = 0; n < n_pairs; n++) {
+            std::map<uint32_t, uint32_t> a, b;
+            for (size_t i = 0; i < 150; i++) {
+                auto index = index_dis(generator);
+                auto weight = weight_dis(generator);
+                a[index] = weight;
+                if (noise(generator) != 0) b[index] = weight + noise(generator); // b 和 a 部分相同
+            }
+            for (size_t i = 0; i < 30; i++) b[index_dis(generator)] = weight_dis(generator);
+            sparse_weight_vector_t A(a.begin(), a.end()), B(b.begin(), b.end());
+            auto actual = generalized_jaccard_similarity(A, B);
+            WeightMinHash<dim, uint32_t, n_sample> hash_A, hash_B;
+            WeightMinHash<dim, uint32_t, n_sample, 1, Philox4x32> counter_hash_A, counter_hash_B;
+            hash_A.update(A);
+            hash_B.update(B);
+            counter_hash_A.update(A);
+            counter_hash_B.update(B);
+            error += std::fabs(weight_minhash_jaccard(hash_A, hash_B) - actual);
+            counter_error += std::fabs(weight_minhash_jaccard(counter_hash_A, counter_hash_B) - actual);
+        }
+        // 均匀分布的端点: 全 1 / 全 0 的输入也必须落在 (0,1) 开区间, u1 * u2 < 1, 取 log 以后有限
+        const float u_max = Philox4x32::uniform23(~0u), u_min = Philox4x32::uniform23(0u);
+        bool open_interval = u_max < 1.0f && u_min > 0.0f && -std::log(u_max * u_max) > 0.0f &&
+                             std::isfinite(std::log(-std::log(u_max * u_max)));
+#ifdef __AVX2__
+        alignas(32) float lanes[8];
+        _mm256_store_ps(lanes, Philox4x32::uniform23(_mm256_setr_epi32(-1, 0, 1, 2, 3, 4, 5, -1)));
+        open_interval &= lanes[0] == u_max && lanes[1] == u_min;
+#endif
+        std::cout << std::boolalpha << "mean abs error : sample matrix " << error / n_pairs
+                  << "  counter-based " << counter_error / n_pairs << "  open interval : " << open_interval << "\n";
+
+        // 稀疏实现的 counter-based 模式不依赖全局位置编码, 元素编号就是 k-mer 的 2-bit 编码, 所以:
+        //   1. 先处理过其他集合, 或者集合以不同的顺序遍历, sketch 都不变;
+        //   2. 和稠密 counter-based 实现 (下标 = 2-bit 编码) 以及 StreamingWeightMinHash 的 sketch 完全相同.
+        constexpr size_t k = 6;
+        using shingling_t = DNA_Shingling<k, WeightFlag::has_weight>;
+        using sparse_weight_minhash_t = WeightMinHash<200000, shingling_t, n_sample, 1, Philox4x32>;
+        std::string read_1 = "ATCGGCTAGCTAGGCTAGCTTAGCGATCGATCGGATCGATTAGCGCTAGCTAGCTAGCGGATCG";
+        std::string read_2 = "GGCTAGCTAGCTTAGCGATCGATCGGATCGATTAGCGCTAGCTAGCTAGCGGATCGATCGATT";
+        auto set_1 = split_dna_shingling<k, WeightFlag::has_weight>(read_1);
+        std::vector<shingling_t> reversed(set_1.begin(), set_1.end());
+        std::reverse(reversed.begin(), reversed.end());
+        HashSet<shingling_t> reordered_set_1;
+        reordered_set_1.reserve(1024); // 不同的桶个数, 遍历顺序也不同
+        reordered_set_1.insert(reversed.begin(), reversed.end());
+        sparse_weight_minhash_t other, after_other, reordered;
+        other.update(split_dna_shingling<k, WeightFlag::has_weight>(read_2));
+        after_other.update(set_1);
+        reordered.update(reordered_set_1);
+
+        auto counts = dna_kmer_code_count<k>(read_1);
+        std::vector<uint32_t> dense(size_t(1) << (2 * k));
+        for (const auto &[code, count] : counts) dense[code] = count;
+        WeightMinHash<size_t(1) << (2 * k), uint32_t, n_sample, 1, Philox4x32> dense_sketch;
+        dense_sketch.update(dense);
+        StreamingWeightMinHash<n_sample> streaming;
+        for (auto it = counts.rbegin(); it != counts.rend(); ++it) streaming.update(it->first, it->second);
+        std::cout << std::boolalpha << "order independent : " << (after_other.hash_values == reordered.hash_values)
+                  << "  equal to dense : " << (after_other.hash_values == dense_sketch.hash_values)
+                  << "  equal to streaming : " << (after_other.hash_values == streaming.hash_values) << "\n";
+        std::cout << "sketch similarity : " << weight_minhash_jaccard(after_other, other) << "  actual : "
+                  << generalized_jaccard_similarity(set_1, split_dna_shingling<k, WeightFlag::has_weight>(read_2))
+                  << "\n";
+    }
+
+    void test_weighted_sketcher() {
+        std::cout << "============ Test weighted sketcher context. =============\n";
+        constexpr size_t k = 6, dim = 200000, n_sample = 128, n_reads = 2000;
+        using Element = DNA_Shingling<k, WeightFlag::has_weight>;
+        using weight_minhash_t = WeightMinHash<dim, Element, n_sample>;
+        std::mt19937_64 generator(6);
+        std::uniform_int_distribution<size_t> base(0, 3);
+        std::vector<HashSet<Element>> sets(n_reads);
+        for (auto &set : sets) {
+            std::string read;
+            for (size_t i = 0; i < 150; i++) read += "ATCG"[base(generator)];
+            set = split_dna_shingling<k, WeightFlag::has_weight>(read);
+        }
+        // 1. 两个独立的上下文按相同顺序处理相同的语料, 位置编码空间互不影响, sketch 完全相同
+        weight_minhash_t::Context context_1(dim), context_2(dim);
+        size_t isolation_mismatch = 0;
+        for (const auto &set : sets) {
+            weight_minhash_t a(context_1), b(context_2);
+            a.update(set);
+            b.update(set);
+            if (a.hash_values != b.hash_values) isolation_mismatch++;
+        }
+        // 2. 多线程共享同一个上下文并行计算, 结果和之后在同一个上下文上串行重新计算的结果一致
+        weight_minhash_t::Context shared_context(dim);
+        std::vector<weight_minhash_t> parallel_sketches(n_reads, weight_minhash_t(shared_context));
+#pragma omp parallel for num_threads(8)
+        for (size_t i = 0; i < n_reads; i++) {
+            parallel_sketches[i].update(sets[i]);
+        }
+        size_t parallel_mismatch = 0;
+        for (size_t i = 0; i < n_reads; i++) {
+            weight_minhash_t temp(shared_context);
+            temp.update(sets[i]);
+            if (temp.hash_values != parallel_sketches[i].hash_values) parallel_mismatch++;
+        }
+        // 3. 元素个数超过 dim 时抛出 std::length_error, 已经分配的位置编码不受影响, 上下文可以继续使用
+        weight_minhash_t::Context small_context(10);
+        bool overflow_thrown = false;
+        try {
+            weight_minhash_t overflow(small_context);
+            overflow.update(sets[0]);
+        } catch (const std::length_error &) {
+            overflow_thrown = true;
+        }
+        bool overflow_usable = small_context.size() == 10 && small_context.position(sets[0].begin()->value()) < 10;
+        std::cout << std::boolalpha << "isolation mismatch : " << isolation_mismatch << "  parallel mismatch : "
+                  << parallel_mismatch << "  positions : " << context_1.size() << " / " << shared_context.size()
+                  << "  overflow thrown : " << overflow_thrown << "  usable after overflow : " << overflow_usable
+                  << "\n";
+    }
+
+    void test_packed_weight_minhash() {
+        std::cout << "============ Test packed weight minhash and weighted LSH. =============\n";
+        constexpr size_t dim = 4096, n_sample = 128, n_clusters = 20, n_docs = 2000;
+        using sparse_weight_vector_t = std::vector<std::pair<uint32_t, uint32_t>>;
+        using weight_minhash_t = WeightMinHash<dim, uint32_t, n_sample>;
+        std::mt19937_64 generator(7);
+        std::uniform_int_distribution<uint32_t> index_dis(0, dim - 1), weight_dis(1, 8), noise(0, 9);
+        std::vector<std::map<uint32_t, uint32_t>> centers(n_clusters);
+        for (auto &center : centers) {
+            for (size_t i = 0; i < 100; i++) center[index_dis(generator)] = weight_dis(generator);
+        }
+        std::vector<weight_minhash_t> sketches(n_docs);
+        std::vector<PackedWeightMinHash<n_sample>> packed_sketches;
+        std::vector<PackedWeightMinHash<n_sample, uint32_t>> packed32_sketches;
+        LSH<XXUInt64Hash64, size_t, 0, 0, n_sample> lsh(0.7, {0.1, 0.9});
+        for (size_t i = 0; i < n_docs; i++) {
+            std::map<uint32_t, uint32_t> doc;
+            for (const auto &[index, weight] : centers[i % n_clusters]) {
+                if (noise(generator) != 0) doc[index] = weight + (noise(generator) == 0); // 少量扰动
+            }
+            sketches[i].update(sparse_weight_vector_t(doc.begin(), doc.end()));
+            packed_sketches.emplace_back(sketches[i]);
+            packed32_sketches.emplace_back(sketches[i]);
+            lsh.insert(sketches[i], i);
+        }
+        // 指纹比较的结果应该和原始 (k*, t_k*) 比较的结果一致
+        double max_diff = 0, max_diff32 = 0;
+        for (size_t i = 1; i < n_docs; i++) {
+            auto sim = weight_minhash_jaccard(sketches[0], sketches[i]);
+            max_diff = std::max(max_diff, std::fabs(sim - weight_minhash_jaccard(packed_sketches[0], packed_sketches[i])));
+            max_diff32 = std::max(max_diff32,
+                                  std::fabs(sim - weight_minhash_jaccard(packed32_sketches[0], packed32_sketches[i])));
+        }
+        // 同一个簇的文档应该被查询出来, 不同簇的文档几乎不会出现在候选集中
+        size_t same_cluster = 0, other_cluster = 0;
+        for (size_t i = 0; i < n_clusters; i++) {
+            for (const auto &candidate : lsh.query(packed_sketches[i])) {
+                if (candidate % n_clusters == i) same_cluster++; else other_cluster++;
+            }
+        }
+        std::cout << "max jaccard diff : 64-bit " << max_diff << "  32-bit " << max_diff32 << "\n";
+        std::cout << "recall : " << (double) same_cluster / (double) n_docs << "  other cluster candidates : "
+                  << other_cluster << "\n";
+        lsh.print_config();
+    }
+
+    void test_streaming_weight_minhash() {
+        std::cout << "============ Test streaming weight minhash. =============\n";
+        constexpr size_t dim = 4096, n_sample = 128;
+        using sparse_weight_vector_t = std::vector<std::pair<uint32_t, uint32_t>>;
+        using streaming_t = StreamingWeightMinHash<n_sample>;
+        std::mt19937_64 generator(8);
+        std::uniform_int_distribution<uint32_t> index_dis(0, dim - 1), weight_dis(1, 16);
+        std::map<uint32_t, uint32_t> doc_a, doc_b;
+        for (size_t i = 0; i < 300; i++) doc_a[index_dis(generator)] = weight_dis(generator);
+        for (size_t i = 0; i < 300; i++) doc_b[index_dis(generator)] = weight_dis(generator);
+        sparse_weight_vector_t vector_a(doc_a.begin(), doc_a.end());
+        // 1. 乱序分成两部分分别更新再 merge, 结果和 counter-based 模式的 dense WeightMinHash 相同
+        WeightMinHash<dim, uint32_t, n_sample, 1, Philox4x32> dense;
+        dense.update(vector_a);
+        sparse_weight_vector_t shuffled = vector_a;
+        std::shuffle(shuffled.begin(), shuffled.end(), generator);
+        streaming_t part_1, part_2;
+        part_1.update(sparse_weight_vector_t(shuffled.begin(), shuffled.begin() + shuffled.size() / 2));
+        part_2.update(sparse_weight_vector_t(shuffled.begin() + shuffled.size() / 2, shuffled.end()));
+        part_1.merge(part_2);
+        // 2. 权重是累加的: 同一个元素 1+1+1 和一次 update 权重 3 的 sketch 相同;
+        //    把 doc_a 的每个权重拆成 1 的增量乱序输入, 结果也和 dense sketch 相同
+        streaming_t ones, three;
+        for (size_t i = 0; i < 3; i++) ones.update(uint64_t(7), 1);
+        three.update(uint64_t(7), 3);
+        sparse_weight_vector_t unit_stream;
+        for (const auto &[index, weight] : vector_a) unit_stream.insert(unit_stream.end(), weight, {index, 1});
+        std::shuffle(unit_stream.begin(), unit_stream.end(), generator);
+        streaming_t incremental;
+        for (const auto &[index, weight] : unit_stream) incremental.update(index, weight);
+        // 3. merge 的结果等于逐元素求和以后的 sketch
+        std::map<uint32_t, uint32_t> doc_sum = doc_a;
+        for (const auto &[index, weight] : doc_b) doc_sum[index] += weight;
+        streaming_t a, b, sum_sketch;
+        a.update(vector_a);
+        b.update(sparse_weight_vector_t(doc_b.begin(), doc_b.end()));
+        sum_sketch.update(sparse_weight_vector_t(doc_sum.begin(), doc_sum.end()));
+        a.merge(b);
+        std::cout << std::boolalpha << "equal to dense : " << (part_1.hash_values == dense.hash_values)
+                  << "  1+1+1 equals 3 : " << (ones.hash_values == three.hash_values && ones.weight(7) == 3)
+                  << "  unit increments equal to dense : " << (incremental.hash_values == dense.hash_values)
+                  << "  merge equals sum : " << (a.hash_values == sum_sketch.hash_values && a.size() == doc_sum.size())
+                  << "  empty : " << streaming_t().empty() << " / " << a.empty() << "\n";
+    }
+
+    void test_prob_minhash() {
+        std::cout << "============ Test prob minhash. =============\n";
+        constexpr size_t n_sample = 256, n_pairs = 100;
+        using sparse_weight_vector_t = std::vector<std::pair<uint32_t, uint32_t>>;
+        std::mt19937_64 generator(9);
+        std::uniform_int_distribution<uint32_t> index_dis(0, 999), weight_dis(1, 10);
+        double error = 0;
+        bool scale_invariant = true, dense_equal = true;
+        for (size_t i = 0; i < n_pairs; i++) {
+            std::map<uint32_t, uint32_t> doc_a, doc_b;
+            for (size_t j = 0; j < 200; j++) doc_a[index_dis(generator)] = weight_dis(generator);
+            for (size_t j = 0; j < 200; j++) doc_b[index_dis(generator)] = weight_dis(generator);
+            sparse_weight_vector_t a(doc_a.begin(), doc_a.end()), b(doc_b.begin(), doc_b.end()), scaled_a = a;
+            std::vector<uint32_t> dense_a(1000, 0);
+            for (auto &[index, weight] : scaled_a) {
+                dense_a[index] = weight;
+                weight *= 3;
+            }
+            ProbMinHash<n_sample> hash_a, hash_b, hash_scaled_a, hash_dense_a;
+            hash_a.update(a);
+            hash_b.update(b);
+            hash_scaled_a.update(scaled_a);
+            hash_dense_a.update(dense_a);
+            error += std::fabs(weight_minhash_jaccard(hash_a, hash_b) - probability_jaccard_similarity(a, b));
+            // 整体缩放不改变 sketch, 稠密和稀疏输入的 sketch 相同
+            scale_invariant &= hash_a.hash_values == hash_scaled_a.hash_values;
+            dense_equal &= hash_a.hash_values == hash_dense_a.hash_values;
+        }
+        std::cout << std::boolalpha << "mean abs error : " << error / n_pairs << "  scale invariant : "
+                  << scale_invariant << "  dense equals sparse : " << dense_equal << "\n";
+    }
+
+    void test_simhash() {
+        std::cout << "============ Test simhash. =============\n";
+        constexpr size_t dim = 1000, n_bits = 512, n_vectors = 2000;
+        using simhash_t = SimHash<n_bits>;
+        simhash_t simhash(dim);
+        std::mt19937_64 generator(10);
+        std::normal_distribution<float> normal(0, 1);
+        std::uniform_int_distribution<uint32_t> index_dis(0, dim - 1), weight_dis(1, 10);
+        // 稀疏向量, 奇数位置的向量是前一个向量加上随机扰动, 余弦相似度覆盖较大范围
+        std::vector<std::vector<std::pair<uint32_t, uint32_t>>> sparse_batch(n_vectors);
+        simhash_t::Matrix dense_batch = simhash_t::Matrix::Zero(dim, n_vectors);
+        for (size_t i = 0; i < n_vectors; i++) {
+            std::map<uint32_t, uint32_t> doc;
+            if (i % 2 == 1) {
+                doc.insert(sparse_batch[i - 1].begin(), sparse_batch[i - 1].end());
+                for (size_t j = 0; j < i % 100; j++) doc[index_dis(generator)] = weight_dis(generator);
+            } else {
+                for (size_t j = 0; j < 100; j++) doc[index_dis(generator)] = weight_dis(generator);
+            }
+            sparse_batch[i].assign(doc.begin(), doc.end());
+            for (const auto &[index, weight] : doc) dense_batch(index, i) = (float) weight;
+        }
+        TimeVar start = timeNow();
+        auto dense_values = simhash.sketch_batch(dense_batch);
+        auto batch_time = millisecond_duration(timeNow() - start);
+        start = timeNow();
+        std::vector<simhash_t::HashValue> single_values;
+        for (size_t i = 0; i < n_vectors; i++) {
+            single_values.push_back(simhash.sketch(simhash_t::Vector(dense_batch.col(i))));
+        }
+        auto single_time = millisecond_duration(timeNow() - start);
+        auto sparse_values = simhash.sketch_batch(sparse_batch);
+        size_t mismatch = 0;
+        double error = 0;
+        for (size_t i = 0; i < n_vectors; i++) {
+            // 浮点累加顺序不同, 投影接近 0 的位可能不同, 这里只统计完全不同的指纹个数
+            if (hamming_distance(dense_values[i], single_values[i]) > 2 ||
+                hamming_distance(dense_values[i], sparse_values[i]) > 2 ||
+                hamming_distance(dense_values[i], simhash.sketch(sparse_batch[i])) > 2) {
+                mismatch++;
+            }
+            if (i % 2 == 1) {
+                error += std::fabs(simhash_cosine_similarity(sparse_values[i - 1], sparse_values[i]) -
+                                   cosine_similarity(sparse_batch[i - 1], sparse_batch[i]));
+            }
+        }
+        // 零向量 (包括 -0.0) 的投影都是 ±0, 按 >= 0 的规则所有位都是 1, 与 AVX2 / 标量路径无关
+        bool zero_all_ones = true;
+        for (float zero : {0.0f, -0.0f}) {
+            auto value = simhash.sketch(simhash_t::Vector(simhash_t::Vector::Constant(dim, zero)));
+            for (const auto &word : value) zero_all_ones &= (word == ~uint64_t(0));
+        }
+        std::cout << std::boolalpha << "mismatch : " << mismatch << "  mean abs error : " << error / (n_vectors / 2)
+                  << "  zero all ones : " << zero_all_ones << "  batch time : " << batch_time << " ms  single time : "
+                  << single_time << " ms\n";
+    }
+
+    void test_hamming_index() {
+        std::cout << "============ Test hamming index. =============\n";
+        constexpr size_t max_distance = 3, n_fingerprints = 200000, n_queries = 200;
+        std::mt19937_64 generator(11);
+        std::uniform_int_distribution<size_t> bit_dis(0, 63), flip_dis(0, max_distance + 1);
+        std::vector<uint64_t> fingerprints;
+        std::vector<size_t> labels;
+        // 每 10 个指纹中, 后 9 个是第一个随机翻转 0 ~ max_distance+1 位得到的
+        for (size_t i = 0; i < n_fingerprints; i++) {
+            uint64_t fingerprint = generator();
+            if (i % 10 != 0) {
+                fingerprint = fingerprints[i - i % 10];
+                for (size_t j = flip_dis(generator); j > 0; j--) fingerprint ^= uint64_t(1) << bit_dis(generator);
+            }
+            fingerprints.push_back(fingerprint);
+            labels.push_back(i);
+        }
+        HammingIndex<max_distance> index;
+        TimeVar start = timeNow();
+        index.build(fingerprints, labels);
+        auto build_time = millisecond_duration(timeNow() - start);
+        std::vector<uint64_t> queries;
+        for (size_t i = 0; i < n_queries; i++) queries.push_back(fingerprints[i * 10]);
+        start = timeNow();
+        auto results = index.query(queries);
+        auto query_time = millisecond_duration(timeNow() - start);
+        // 与线性扫描的结果比较
+        size_t mismatch = 0, found = 0;
+        for (size_t i = 0; i < n_queries; i++) {
+            std::vector<size_t> expect;
+            for (size_t j = 0; j < n_fingerprints; j++) {
+                if (__builtin_popcountll(queries[i] ^ fingerprints[j]) <= (int) max_distance) expect.push_back(j);
+            }
+            std::sort(results[i].begin(), results[i].end());
+            if (results[i] != expect) mismatch++;
+            found += expect.size();
+        }
+        // 保存后 mmap 加载, 查询结果不变
+        std::string path = "hamming_index_test.bin";
+        index.save(path);
+        HammingIndex<max_distance> loaded;
+        loaded.load(path);
+        auto loaded_results = loaded.query(queries);
+        size_t load_mismatch = 0;
+        for (size_t i = 0; i < n_queries; i++) {
+            std::sort(loaded_results[i].begin(), loaded_results[i].end());
+            if (loaded_results[i] != results[i]) load_mismatch++;
+        }
+        loaded.print_config();
+        // 损坏的文件头: size 加上 2^58, n_tables * size * sizeof(Entry) 溢出以后正好等于原来的长度, 必须被拒绝;
+        // 文件不存在时抛出 std::system_error. 失败的 load 不影响已经加载的内容
+        const std::string corrupt_path = "hamming_index_corrupt.bin";
+        std::filesystem::copy_file(path, corrupt_path, std::filesystem::copy_options::overwrite_existing);
+        {
+            std::fstream corrupt(corrupt_path, std::ios::binary | std::ios::in | std::ios::out);
+            uint64_t size = n_fingerprints + (uint64_t(1) << 58u);
+            corrupt.seekp(32);
+            corrupt.write(reinterpret_cast<const char *>(&size), sizeof(size));
+        }
+        bool corrupt_rejected = false, missing_rejected = false;
+        try {
+            loaded.load(corrupt_path);
+        } catch (const std::runtime_error &) {
+            corrupt_rejected = true;
+        }
+        try {
+            loaded.load("hamming_index_missing.bin");
+        } catch (const std::system_error &e) {
+            missing_rejected = e.code() == std::errc::no_such_file_or_directory;
+        }
+        bool usable_after_error = loaded.query(queries[0]).size() == results[0].size();
+        std::filesystem::remove(path);
+        std::filesystem::remove(corrupt_path);
+        std::cout << std::boolalpha << "mismatch : " << mismatch << "  load mismatch : " << load_mismatch
+                  << "  found : " << found << "  corrupt rejected : " << corrupt_rejected << "  missing rejected : "
+                  << missing_rejected << "  usable after error : " << usable_after_error << "\nbuild time : "
+                  << build_time << " ms  query time : " << query_time << " ms\n";
+    }
+
+    void test_kmer_natural_vector() {
+        std::cout << "============ Test k-mer natural vector. =============\n";
+        // "ATATA", k = 2: AT 位于 1,3; TA 位于 2,4. μ_AT = 2, μ_TA = 3, D = ((-1)^2 + 1^2) / (2 * 5) = 0.2
+        auto example = kmer_natural_vector<2>("ATATA");
+        bool example_correct = example.components.size() == 2 &&
+                               example.components[0].count == 2 && example.components[0].mean == 2.0f &&
+                               std::fabs(example.components[0].moment - 0.2f) < 1e-6 &&
+                               example.components[1].mean == 3.0f;
+        // 每条 read 和它的副本 (随机替换 1 个碱基) 组成一对, 检查副本能否被查询出来
+        constexpr size_t k = 5, n_reads = 10000;
+        std::mt19937_64 generator(12);
+        std::uniform_int_distribution<size_t> base(0, 3), position(0, 149);
+        std::vector<std::string> reads, copies;
+        std::vector<size_t> labels;
+        for (size_t i = 0; i < n_reads; i++) {
+            std::string read;
+            for (size_t j = 0; j < 150; j++) read += "ATCG"[base(generator)];
+            std::string copy = read;
+            copy[position(generator)] = "ATCG"[base(generator)];
+            reads.push_back(read);
+            copies.push_back(copy);
+            labels.push_back(i);
+        }
+        NaturalVectorIndex<k, 6> index;
+        TimeVar start = timeNow();
+        index.build(reads, labels);
+        auto build_time = millisecond_duration(timeNow() - start);
+        auto results = index.query(copies);
+        size_t found = 0, candidates = 0;
+        for (size_t i = 0; i < n_reads; i++) {
+            found += std::count(results[i].begin(), results[i].end(), i);
+            candidates += results[i].size();
+        }
+        // 同样数量的 read 计算 MinHash 的时间
+        start = timeNow();
+        for (const auto &read : reads) {
+            MinHash<StdDNAShinglingHash64<k>, 32, 128> minhash;
+            minhash.update(split_dna_shingling<k, WeightFlag::no_weight>(read));
+        }
+        auto minhash_time = millisecond_duration(timeNow() - start);
+        std::cout << std::boolalpha << "example correct : " << example_correct << "  recall : "
+                  << (double) found / n_reads << "  candidates per query : " << (double) candidates / n_reads
+                  << "\nnatural vector index build time : " << build_time << " ms  minhash time : "
+                  << minhash_time << " ms\n";
+    }
+
+    void test_hyperloglog() {
+        std::cout << "============ Test hyperloglog. =============\n";
+        using HLL = HyperLogLog<XXUInt64Hash64, 14>;
+        for (size_t n : {100ul, 10000ul, 1000000ul, 10000000ul}) {
+            // 分成 8 个部分并行计算再合并, 结果和串行计算相同
+            constexpr size_t n_parts = 8;
+            HLL serial;
+            std::vector<HLL> parts(n_parts);
+            for (uint64_t i = 0; i < n; i++) serial.update(i);
+#pragma omp parallel for num_threads(n_parts)
+            for (size_t part = 0; part < n_parts; part++) {
+                for (uint64_t i = part; i < n; i += n_parts) parts[part].update(i);
+            }
+            HLL merged;
+            for (const auto &part : parts) merged.merge(part);
+            std::cout << "n : " << n << "  estimate : " << serial.cardinality() << "  relative error : "
+                      << std::fabs(serial.cardinality() - (double) n) / (double) n << "  merged equal : "
+                      << std::boolalpha << (merged.cardinality() == serial.cardinality()) << "  sparse : "
+                      << serial.is_sparse() << "  memory : " << serial.memory_size() << " bytes\n";
+        }
+        // 与 HashSet 统计的不同 k-mer 个数比较
+        constexpr size_t k = 12;
+        std::mt19937_64 generator(13);
+        std::uniform_int_distribution<size_t> base(0, 3);
+        std::string genome;
+        for (size_t i = 0; i < 2000000; i++) genome += "ATCG"[base(generator)];
+        auto k_mers = split_dna_shingling<k, WeightFlag::no_weight>(genome);
+        HyperLogLog<StdDNAShinglingHash64<k>> k_mer_hll;
+        k_mer_hll.update(k_mers);
+        std::cout << "distinct k-mers : " << k_mers.size() << "  estimate : " << k_mer_hll.cardinality() << "\n";
+    }
+
+    void test_minhash_containment() {
+        std::cout << "============ Test minhash containment. =============\n";
+        constexpr size_t k = 12, n_genomes = 8, n_permutation = 1024;
+        using MinHashType = MinHash<StdDNAShinglingHash64<k>, 64, n_permutation>;
+        using HLL = HyperLogLog<StdDNAShinglingHash64<k>, 12>;
+        std::mt19937_64 generator(14);
+        std::uniform_int_distribution<size_t> base(0, 3);
+        std::vector<std::string> genomes(n_genomes);
+        std::vector<MinHashType> genome_minhash(n_genomes);
+        std::vector<double> genome_sizes;
+        std::vector<HLL> genome_hll(n_genomes);
+        std::vector<HashSet<DNA_Shingling<k, WeightFlag::no_weight>>> genome_sets;
+        for (size_t i = 0; i < n_genomes; i++) {
+            for (size_t j = 0; j < 20000; j++) genomes[i] += "ATCG"[base(generator)];
+            genome_sets.push_back(split_dna_shingling<k, WeightFlag::no_weight>(genomes[i]));
+            genome_minhash[i].update(genome_sets[i]);
+            genome_hll[i].update(genome_sets[i]);
+            genome_sizes.push_back((double) genome_sets[i].size());
+        }
+        // read 取自第 0 个 genome, 对第 0 个 genome 的包含度接近 1, 对其他 genome 接近 0
+        auto read_set = split_dna_shingling<k, WeightFlag::no_weight>(genomes[0].substr(5000, 3000));
+        MinHashType read_minhash;
+        HLL read_hll;
+        read_minhash.update(read_set);
+        read_hll.update(read_set);
+        auto batch = minhash_containment(read_minhash, (double) read_set.size(), genome_minhash, genome_sizes);
+        double max_error = 0, max_hll_error = 0;
+        for (size_t i = 0; i < n_genomes; i++) {
+            double exact = containment(read_set, genome_sets[i]);
+            max_error = std::max(max_error, std::fabs(batch[i] - exact));
+            max_hll_error = std::max(max_hll_error, std::fabs(
+                    minhash_containment(read_minhash, genome_minhash[i], read_hll, genome_hll[i]) - exact));
+        }
+        std::cout << "containment in source genome : " << batch[0] << "  exact : "
+                  << containment(read_set, genome_sets[0]) << "  jaccard : "
+                  << jaccard_similarity(read_set, genome_sets[0]) << "\nmax error (exact size) : " << max_error
+                  << "  max error (hll size) : " << max_hll_error << "\n";
+    }
+
+    void test_super_minhash() {
+        std::cout << "============ Test super minhash. =============\n";
+        constexpr size_t n_permutation = 128, n_docs = 1000, n_clusters = 50;
+        using SuperMinHashType = SuperMinHash<XXUInt64Hash64, n_permutation>;
+        std::mt19937_64 generator(15);
+        std::uniform_int_distribution<size_t> noise(0, 9);
+        std::vector<HashSet<uint64_t>> centers(n_clusters);
+        for (auto &center : centers) {
+            while (center.size() < 100) center.insert(generator());
+        }
+        // 同一个簇的文档只替换了少量元素, 应该被 LSH 查询出来
+        std::vector<SuperMinHashType> sketches(n_docs);
+        LSH<XXUInt64Hash64, size_t, 0, 0, n_permutation> lsh(0.7, {0.1, 0.9});
+        std::vector<HashSet<uint64_t>> docs(n_docs);
+        for (size_t i = 0; i < n_docs; i++) {
+            for (const auto &value : centers[i % n_clusters]) docs[i].insert(noise(generator) == 0 ? generator() : value);
+            sketches[i].update(docs[i]);
+            lsh.insert(sketches[i], i);
+        }
+        double error = 0;
+        for (size_t i = n_clusters; i < n_docs; i++) {
+            error += std::fabs(minhash_jaccard_similarity(sketches[i % n_clusters], sketches[i]) -
+                               jaccard_similarity(docs[i % n_clusters], docs[i]));
+        }
+        size_t same_cluster = 0, other_cluster = 0;
+        for (size_t i = 0; i < n_clusters; i++) {
+            for (const auto &candidate : lsh.query(sketches[i])) {
+                if (candidate % n_clusters == i) same_cluster++; else other_cluster++;
+            }
+        }
+        std::cout << "mean abs error : " << error / (n_docs - n_clusters) << "  recall : "
+                  << (double) same_cluster / n_docs << "  other cluster candidates : " << other_cluster << "\n";
+    }
+
+    void test_bottom_k_sketch() {
+        std::cout << "============ Test bottom-k sketch. =============\n";
+        constexpr size_t k = 256;
+        using Sketch = BottomKSketch<XXUInt64Hash64, k>;
+        std::mt19937_64 generator(16);
+        auto make_set = [&](const HashSet<uint64_t> &base, size_t shared, size_t extra) {
+            HashSet<uint64_t> set;
+            for (const auto &value : base) {
+                if (set.size() == shared) break;
+                set.insert(value);
+            }
+            for (size_t i = 0; i < extra; i++) set.insert(generator());
+            return set;
+        };
+        HashSet<uint64_t> base;
+        while (base.size() < 100000) base.insert(generator());
+        // 1. 小集合 (|A|, |B| < k) 的估计是精确的
+        auto small_a = make_set(base, 60, 40), small_b = make_set(base, 60, 100);
+        Sketch sketch_small_a, sketch_small_b;
+        sketch_small_a.update(small_a);
+        sketch_small_b.update(small_b);
+        bool small_exact = minhash_jaccard_similarity(sketch_small_a, sketch_small_b) ==
+                           jaccard_similarity(small_a, small_b) &&
+                           minhash_containment(sketch_small_a, sketch_small_b) == containment(small_a, small_b) &&
+                           sketch_small_b.cardinality() == (double) small_b.size();
+        // 恰好 k 个元素时仍然是精确的, k + 1 个元素时 (直接插入或者 merge 得到) 不再精确
+        auto full_a = make_set(base, k / 2, k / 2), full_b = make_set(base, k / 2, k / 2);
+        Sketch sketch_full_a, sketch_full_b, sketch_over, sketch_over_merged;
+        sketch_full_a.update(full_a);
+        sketch_full_b.update(full_b);
+        sketch_over.update(make_set(base, k + 1, 0));
+        sketch_over_merged.update(make_set(base, k, 0));
+        sketch_over_merged.merge(sketch_over);
+        bool full_exact = sketch_full_a.is_exact() && sketch_full_a.cardinality() == (double) k &&
+                          minhash_jaccard_similarity(sketch_full_a, sketch_full_b) == jaccard_similarity(full_a, full_b) &&
+                          minhash_union_size(sketch_full_a, sketch_full_b) == (double) (full_a.size() + full_b.size() - k / 2);
+        Sketch sketch_full_union = sketch_full_a; // 两个恰好 k 个元素的精确 sketch, 并集超过 k 个元素
+        sketch_full_union.merge(sketch_full_b);
+        bool over_estimated = !sketch_over.is_exact() && !sketch_over_merged.is_exact() && !sketch_full_union.is_exact();
+        // 2. 大集合的 jaccard / containment / 基数估计, 以及分块计算再 merge 等于整体计算
+        auto large_a = make_set(base, 20000, 5000), large_b = make_set(base, 100000, 0);
+        Sketch sketch_a, sketch_b, part_1, part_2;
+        sketch_a.update(large_a);
+        sketch_b.update(large_b);
+        size_t index = 0;
+        for (const auto &value : large_b) (index++ % 2 == 0 ? part_1 : part_2).update(value);
+        part_1.merge(part_2);
+        bool merge_equal = std::equal(part_1.data(), part_1.data() + k, sketch_b.data());
+        std::cout << std::boolalpha << "small exact : " << small_exact << "  exactly k exact : " << full_exact
+                  << "  k + 1 estimated : " << over_estimated << "  merge equal : " << merge_equal
+                  << "\njaccard : " << minhash_jaccard_similarity(sketch_a, sketch_b) << " / "
+                  << jaccard_similarity(large_a, large_b) << "  containment : "
+                  << minhash_containment(sketch_a, sketch_b) << " / " << containment(large_a, large_b)
+                  << "  cardinality : " << sketch_b.cardinality() << " / " << large_b.size() << "\n";
+    }
+
+    void test_parallel_dna_minhash() {
+        std::cout << "============ Test parallel dna minhash. =============\n";
+        constexpr size_t k = 12;
+        using MinHashType = MinHash<StdDNAShinglingHash64<k>, 64, 128>;
+        std::mt19937_64 generator(17);
+        std::uniform_int_distribution<size_t> base(0, 3);
+        std::string genome;
+        for (size_t i = 0; i < 1000000; i++) genome += "ATCG"[base(generator)];
+        TimeVar start = timeNow();
+        MinHashType serial;
+        serial.update(split_dna_shingling<k, WeightFlag::no_weight>(genome));
+        auto serial_time = millisecond_duration(timeNow() - start);
+        start = timeNow();
+        auto parallel = parallel_dna_minhash<k, MinHashType>(genome, 1u << 16u, 8);
+        auto parallel_time = millisecond_duration(timeNow() - start);
+        // 块大小不整除以及块很小 (只有一个 k-mer) 的边界情况
+        auto odd_chunk = parallel_dna_minhash<k, MinHashType>(genome.substr(0, 10000 + k), 10000, 4);
+        MinHashType odd_serial;
+        odd_serial.update(split_dna_shingling<k, WeightFlag::no_weight>(genome.substr(0, 10000 + k)));
+        std::cout << std::boolalpha << "identical : " << (parallel.hash_values == serial.hash_values)
+                  << "  boundary identical : " << (odd_chunk.hash_values == odd_serial.hash_values)
+                  << "  serial time : " << serial_time << " ms  parallel time : " << parallel_time << " ms\n";
+    }
+
+    template<size_t k>
+    using TestDNAMinHash = MinHash<StdDNAShinglingHash64<k>, 64, 128>;
+
+    void test_multi_k_minhash() {
+        std::cout << "============ Test multi-k minhash. =============\n";
+        std::mt19937_64 generator(23);
+        std::uniform_int_distribution<size_t> base(0, 3);
+        std::vector<std::string> reads(200);
+        for (auto &read : reads) {
+            size_t length = 3 + generator() % 300; // 包括比某些 k 短的 read
+            for (size_t i = 0; i < length; i++) read += "ATCG"[base(generator)];
+        }
+        TimeVar start = timeNow();
+        std::vector<MultiKMinHash<TestDNAMinHash, 5, 6, 7, 8, 9>> multi(reads.size());
+        for (size_t i = 0; i < reads.size(); i++) multi[i].update(reads[i]);
+        auto multi_time = millisecond_duration(timeNow() - start);
+        bool identical = true;
+        double separate_time = 0;
+        for_constexpr<for_bounds<5, 10>>([&](auto k_value) {
+            constexpr size_t k = k_value;
+            TimeVar k_start = timeNow();
+            for (size_t i = 0; i < reads.size(); i++) {
+                TestDNAMinHash<k> expect;
+                if (reads[i].size() >= k) expect.update(split_dna_shingling<k, WeightFlag::no_weight>(reads[i]));
+                identical &= (expect.hash_values == multi[i].template get<k>().hash_values);
+            }
+            separate_time += millisecond_duration(timeNow() - k_start);
+        });
+        // 合并两段 (重叠 k_max - 1 个碱基) 等于整条 read
+        MultiKMinHash<TestDNAMinHash, 5, 9> whole, left, right;
+        whole.update(reads[0]);
+        left.update(std::string_view(reads[0]).substr(0, reads[0].size() / 2 + 8));
+        right.update(std::string_view(reads[0]).substr(reads[0].size() / 2));
+        left.merge(right);
+        bool merged = left.get<5>().hash_values == whole.get<5>().hash_values &&
+                      left.get<9>().hash_values == whole.get<9>().hash_values;
+        std::cout << std::boolalpha << "identical : " << identical << "  merge identical : " << merged
+                  << "  multi-k time : " << multi_time << " ms  separate time : " << separate_time << " ms\n";
+    }
+
+    void test_minimizer() {
+        std::cout << "============ Test minimizer. =============\n";
+        constexpr size_t k = 15, w = 10;
+        std::mt19937_64 generator(29);
+        std::uniform_int_distribution<size_t> base(0, 3);
+        auto reverse_complement = [](const std::string &read) {
+            std::string result(read.rbegin(), read.rend());
+            for (auto &ch : result) ch = ch == 'A' ? 'T' : ch == 'T' ? 'A' : ch == 'C' ? 'G' : ch == 'G' ? 'C' : ch;
+            return result;
+        };
+        // 暴力计算: 每个窗口取最左边的最小哈希值
+        std::string read;
+        for (size_t i = 0; i < 5000; i++) read += "ATCG"[base(generator)];
+        read[2500] = 'N';
+        std::vector<Minimizer> expect;
+        for (size_t begin = 0; begin + w + k - 1 <= read.size(); begin++) {
+            std::string_view window = std::string_view(read).substr(begin, w + k - 1);
+            if (window.find('N') != std::string_view::npos) continue;
+            Minimizer best{std::numeric_limits<uint64_t>::max(), 0, false};
+            for (size_t i = 0; i < w; i++) {
+                auto code = dna_shingling_encode<k, WeightFlag::no_weight>(window.substr(i, k)).to_ullong();
+                uint64_t hash = detail::kmer_hash64(code, (uint64_t(1) << (2 * k)) - 1);
+                if (hash < best.hash) best = {hash, static_cast<uint32_t>(begin + i), false};
+            }
+            if (expect.empty() || !(expect.back() == best)) expect.push_back(best);
+        }
+        auto minimizers = dna_minimizers<k, w>(read);
+        bool brute_force = minimizers == expect;
+        auto forward_set = dna_minimizer_hash_set<k, w, true>(read);
+        auto backward_set = dna_minimizer_hash_set<k, w, true>(reverse_complement(read));
+        bool symmetric = forward_set == backward_set;
+        double density = (double) minimizers.size() / (double) (read.size() - k + 1);
+
+        // 长 read 重叠检测: 从 200 kbp 的基因组上采样 10-20 kbp 的 read (1% 替换错误, 一半是反向互补链)
+        std::string genome;
+        for (size_t i = 0; i < 200000; i++) genome += "ATCG"[base(generator)];
+        const size_t n_reads = 60;
+        std::vector<std::string> reads(n_reads);
+        std::vector<std::pair<size_t, size_t>> intervals(n_reads);
+        std::vector<uint32_t> labels(n_reads);
+        for (size_t i = 0; i < n_reads; i++) {
+            size_t length = 10000 + generator() % 10000;
+            size_t begin = generator() % (genome.size() - length);
+            intervals[i] = {begin, begin + length};
+            reads[i] = genome.substr(begin, length);
+            for (auto &ch : reads[i]) if (generator() % 100 == 0) ch = "ATCG"[base(generator)];
+            if (i % 2 == 1) reads[i] = reverse_complement(reads[i]);
+            labels[i] = static_cast<uint32_t>(i);
+        }
+        MinimizerIndex<k, w> index;
+        TimeVar start = timeNow();
+        index.build(reads, labels);
+        auto result = index.overlap(reads, 5);
+        auto index_time = millisecond_duration(timeNow() - start);
+        size_t true_positive = 0, false_positive = 0, n_overlap = 0;
+        for (size_t i = 0; i < n_reads; i++) {
+            for (size_t j = 0; j < n_reads; j++) {
+                if (i == j) continue;
+                auto overlap = std::min(intervals[i].second, intervals[j].second) -
+                               std::min(std::min(intervals[i].second, intervals[j].second),
+                                        std::max(intervals[i].first, intervals[j].first));
+                bool found = false, strand = false;
+                for (const auto &item : result[i]) {
+                    if (item.label == j) {
+                        found = true;
+                        strand = item.same_strand;
+                    }
+                }
+                bool correct = found && overlap > 0 && strand == (i % 2 == j % 2);
+                if (overlap >= 2000) {
+                    n_overlap++;
+                    true_positive += correct;
+                }
+                if (found && !correct) false_positive++;
+            }
+        }
+        std::cout << std::boolalpha << "brute force identical : " << brute_force << "  reverse complement symmetric : "
+                  << symmetric << "  density : " << density << " (2 / (w + 1) = " << 2.0 / (w + 1) << ")\n"
+                  << "index size : " << index.size() << "  overlaps (>= 2 kbp) : " << n_overlap << "  recall : "
+                  << (double) true_positive / (double) n_overlap << "  false positive : " << false_positive << "  time : " << index_time << " ms\n";
+    }
+
+    void test_windowed_minhash() {
+        std::cout << "============ Test windowed minhash. =============\n";
+        constexpr size_t k = 12, window = 2000, stride = 500;
+        using MinHashType = MinHash<StdDNAShinglingHash64<k>, 64, 128>;
+        using LSH_Type = LSH<XXUInt64Hash64, WindowLabel, 32, 4, 128>;
+        std::mt19937_64 generator(31);
+        std::uniform_int_distribution<size_t> base(0, 3);
+        std::string genome_a, genome_b;
+        for (size_t i = 0; i < 100000; i++) genome_a += "ATCG"[base(generator)];
+        for (size_t i = 0; i < 100000; i++) genome_b += "ATCG"[base(generator)];
+        genome_b.replace(70000, 6000, genome_a, 30000, 6000); // 共同区域: a[30000, 36000) == b[70000, 76000)
+        genome_a[50000] = 'N';
+
+        WindowedMinHash<k, MinHashType> windowed(window, stride);
+        TimeVar start = timeNow();
+        auto windows_a = windowed.sketch(genome_a);
+        auto incremental_time = millisecond_duration(timeNow() - start);
+        start = timeNow();
+        bool identical = true;
+        for (const auto &[offset, sketch] : windows_a) {
+            MinHashType expect;
+            auto sub = std::string_view(genome_a).substr(offset, window);
+            if (sub.find('N') == std::string_view::npos) {
+                expect.update(split_dna_shingling<k, WeightFlag::no_weight>(sub));
+                identical &= (expect.hash_values == sketch.hash_values);
+            }
+        }
+        auto scratch_time = millisecond_duration(timeNow() - start);
+        auto short_windows = windowed.sketch(std::string_view(genome_a).substr(0, 1000));
+        MinHashType short_expect;
+        short_expect.update(split_dna_shingling<k, WeightFlag::no_weight>(std::string_view(genome_a).substr(0, 1000)));
+        bool short_identical = short_windows.size() == 1 && short_windows[0].second.hash_values == short_expect.hash_values;
+        bool invalid_rejected = false;
+        try {
+            WindowedMinHash<k, MinHashType> invalid(window, 0);
+        } catch (const std::invalid_argument &) {
+            invalid_rejected = true;
+        }
+
+        LSH_Type lsh;
+        for (const auto &[offset, sketch] : windows_a) lsh.insert(sketch, WindowLabel{0, static_cast<uint32_t>(offset)});
+        size_t n_hits = 0, n_wrong = 0;
+        for (const auto &[offset, sketch] : windowed.sketch(genome_b)) {
+            for (const auto &label : lsh.query(sketch)) {
+                n_hits++;
+                // 命中的两个窗口必须都和共同区域重叠, 并且在共同区域内的位置也有重叠 (b 中的位置 = a 中的位置 + 40000)
+                auto diagonal = static_cast<int64_t>(offset) - static_cast<int64_t>(label.offset) - 40000;
+                bool in_region = offset + window > 70000 && offset < 76000 && label.offset + window > 30000 &&
+                                 label.offset < 36000 && std::abs(diagonal) < static_cast<int64_t>(window);
+                n_wrong += !in_region;
+            }
+        }
+        std::cout << std::boolalpha << "windows : " << windows_a.size() << "  identical : " << identical
+                  << "  short identical : " << short_identical << "  invalid rejected : " << invalid_rejected
+                  << "  shared region hits : " << n_hits
+                  << "  wrong hits : " << n_wrong << "\nincremental time : " << incremental_time
+                  << " ms  from scratch time : " << scratch_time << " ms\n";
+    }
+
+    void test_hyper_minhash() {
+        std::cout << "============ Test hyper minhash. =============\n";
+        using Sketch = HyperMinHash<XXUInt64Hash64>;
+        // A = [0, size_a), B = [size_a - shared, size_a - shared + size_b)
+        const std::vector<std::tuple<uint64_t, uint64_t, uint64_t>> cases = {
+                {1000, 1000, 500}, {100000, 100000, 20000}, {1000000, 1000000, 500000},
+                {1000000, 10000, 10000}, {5000000, 5000000, 4000000}};
+        bool merge_equal = true;
+        for (const auto&[size_a, size_b, shared] : cases) {
+            Sketch A, B, part_1, part_2;
+            for (uint64_t i = 0; i < size_a; i++) {
+                A.update(i);
+                (i % 2 == 0 ? part_1 : part_2).update(i);
+            }
+            for (uint64_t i = size_a - shared; i < size_a - shared + size_b; i++) B.update(i);
+            part_1.merge(part_2);
+            merge_equal &= std::equal(part_1.data(), part_1.data() + Sketch::n_registers, A.data());
+            auto union_size = static_cast<double>(size_a + size_b - shared);
+            std::cout << "|A| : " << size_a << "  |B| : " << size_b << "  cardinality : " << A.cardinality()
+                      << "  union : " << minhash_union_size(A, B) << " / " << union_size << "  jaccard : "
+                      << minhash_jaccard_similarity(A, B) << " / " << (double) shared / union_size
+                      << "  intersection : " << minhash_intersection_size(A, B) << " / " << shared
+                      << "  containment(B, A) : " << minhash_containment(B, A) << " / "
+                      << (double) shared / (double) size_b << "\n";
+        }
+        // read 大小的集合 (碰撞期望走精确求和) 的比较速度; 传入已经估计的基数时结果不变
+        Sketch read_a, read_b;
+        for (uint64_t i = 0; i < 150; i++) read_a.update(i), read_b.update(i + 50);
+        const double cardinality_a = read_a.cardinality(), cardinality_b = read_b.cardinality();
+        constexpr size_t n_compare = 10000;
+        double sum = 0;
+        TimeVar start = timeNow();
+        for (size_t i = 0; i < n_compare; i++) sum += minhash_jaccard_similarity(read_a, read_b, cardinality_a, cardinality_b);
+        auto compare_time = millisecond_duration(timeNow() - start);
+        bool cardinality_equal = minhash_jaccard_similarity(read_a, read_b) ==
+                                 minhash_jaccard_similarity(read_a, read_b, cardinality_a, cardinality_b);
+        std::cout << std::boolalpha << "merge equal : " << merge_equal << "  sketch size : " << Sketch::memory_size()
+                  << " bytes  read jaccard : " << sum / n_compare << " / " << 100.0 / 200.0
+                  << "  cardinality overload equal : " << cardinality_equal << "  compare time : "
+                  << compare_time * 1000 / n_compare << " us\n";
+    }
+
+    void test_sketch_file() {
+        std::cout << "============ Test sketch file. =============\n";
+        constexpr size_t k = 12;
+        using MinHashType = MinHash<StdDNAShinglingHash64<k>, 32, 128>;
+        using SketchFileType = SketchFile<MinHashType>;
+        std::mt19937_64 generator(37);
+        std::uniform_int_distribution<size_t> base(0, 3);
+        const size_t n_sketches = 300;
+        std::vector<MinHashType> sketches(n_sketches);
+        std::vector<std::string> names(n_sketches);
+        for (size_t i = 0; i < n_sketches; i++) {
+            std::string read;
+            for (size_t j = 0; j < 500; j++) read += "ATCG"[base(generator)];
+            sketches[i].update(split_dna_shingling<k, WeightFlag::no_weight>(read));
+            names[i] = "read_" + std::to_string(i) + (i % 7 == 0 ? "" : " sample=" + std::to_string(i % 5));
+        }
+        const std::string path = "/tmp/lsh_cpp_test.sketch";
+        TimeVar start = timeNow();
+        SketchFileType::save(path, sketches, names);
+        auto save_time = millisecond_duration(timeNow() - start);
+        start = timeNow();
+        SketchFileType file(path);
+        auto load_time = millisecond_duration(timeNow() - start);
+        bool identical = file.size() == n_sketches;
+        for (size_t i = 0; i < file.size() && identical; i++) {
+            identical = file.name(i) == names[i] && file.to_minhash(i).hash_values == sketches[i].hash_values &&
+                        reinterpret_cast<uintptr_t>(file.row(i)) % 64 == (i * 128 * sizeof(uint32_t)) % 64 &&
+                        file.jaccard_similarity(sketches[0], i) == minhash_jaccard_similarity(sketches[0], sketches[i]);
+        }
+        // concat 两个文件, 再取子集
+        const std::string concat_path = "/tmp/lsh_cpp_test_concat.sketch", subset_path = "/tmp/lsh_cpp_test_subset.sketch";
+        SketchFileType::concat(concat_path, {path, path});
+        SketchFileType concat_file(concat_path);
+        concat_file.subset(subset_path, {n_sketches + 5, 3, 3});
+        SketchFileType subset_file(subset_path);
+        bool concat_ok = concat_file.size() == 2 * n_sketches && concat_file.name(n_sketches + 1) == names[1] &&
+                         concat_file.to_minhash(n_sketches + 1).hash_values == sketches[1].hash_values;
+        bool subset_ok = subset_file.size() == 3 && subset_file.name(0) == names[5] && subset_file.name(2) == names[3] &&
+                         subset_file.to_minhash(1).hash_values == sketches[3].hash_values;
+        // 不退出的检查: 完整的文件有效; 不存在, 被截断, 或者 MinHash 参数不同的文件无效, try_load 失败时保留之前的内容
+        const std::string truncated_path = "/tmp/lsh_cpp_test_truncated.sketch";
+        const std::string other_path = "/tmp/lsh_cpp_test_other.sketch";
+        std::filesystem::copy_file(path, truncated_path, std::filesystem::copy_options::overwrite_existing);
+        std::filesystem::resize_file(truncated_path, std::filesystem::file_size(path) - 1);
+        using OtherMinHashType = MinHash<StdDNAShinglingHash64<k>, 32, 64>;
+        SketchFile<OtherMinHashType>::save(other_path, std::vector<OtherMinHashType>(2), {"a", "b"});
+        SketchFileType reload;
+        bool validity = SketchFileType::is_valid(path) && !SketchFileType::is_valid("/tmp/lsh_cpp_test_missing.sketch") &&
+                        !SketchFileType::is_valid(truncated_path) && !SketchFileType::is_valid(other_path) &&
+                        reload.try_load(path) && !reload.try_load(truncated_path) && !reload.try_load(other_path) &&
+                        reload.size() == n_sketches && reload.name(1) == names[1];
+        // 名字偏移损坏 (offsets[2] 超出 names) 的文件无效; load 失败和 save / subset 失败都抛出异常, 不退出进程
+        const std::string corrupt_path = "/tmp/lsh_cpp_test_corrupt_names.sketch";
+        std::filesystem::copy_file(path, corrupt_path, std::filesystem::copy_options::overwrite_existing);
+        {
+            std::fstream corrupt(corrupt_path, std::ios::binary | std::ios::in | std::ios::out);
+            uint64_t offset = uint64_t(1) << 40u;
+            corrupt.seekp(static_cast<std::streamoff>(72 + 2 * sizeof(uint64_t))); // 文件头 72 字节
+            corrupt.write(reinterpret_cast<const char *>(&offset), sizeof(offset));
+        }
+        validity &= !SketchFileType::is_valid(corrupt_path);
+        size_t n_thrown = 0;
+        try {
+            reload.load(corrupt_path);
+        } catch (const std::runtime_error &) {
+            n_thrown++;
+        }
+        try {
+            reload.load("/tmp/lsh_cpp_test_missing.sketch");
+        } catch (const std::system_error &) {
+            n_thrown++;
+        }
+        try {
+            SketchFileType::save("/tmp/lsh_cpp_missing_directory/test.sketch", sketches, names);
+        } catch (const std::system_error &) {
+            n_thrown++;
+        }
+        try {
+            reload.subset(subset_path, {n_sketches});
+        } catch (const std::out_of_range &) {
+            n_thrown++;
+        }
+        validity &= n_thrown == 4 && reload.size() == n_sketches;
+        std::cout << std::boolalpha << "identical : " << identical << "  concat : " << concat_ok << "  subset : "
+                  << subset_ok << "  validity : " << validity << "  file size : " << std::filesystem::file_size(path)
+                  << " bytes  save time : " << save_time << " ms  load time : " << load_time << " ms\n";
+        std::remove(path.c_str());
+        std::remove(concat_path.c_str());
+        std::remove(subset_path.c_str());
+        std::remove(truncated_path.c_str());
+        std::remove(other_path.c_str());
+        std::remove(corrupt_path.c_str());
+    }
+
     void test() {
         //init();
         //test_hash_map_performance();
@@ -301,6 +1701,31 @@ namespace LSH_CPP::Test {
         test_dna_shingling();
         test_parallel_get_mean();
         test_hash_map_set_construct_emplace();
+        test_lsh_hot_swap();
+        test_query_server();
+        test_compressed_posting_list();
+        test_external_lsh();
+        test_sharded_lsh();
+        test_icws_kernel();
+        test_weight_minhash_sparse_update();
+        test_weight_minhash_counter_sample();
+        test_weighted_sketcher();
+        test_packed_weight_minhash();
+        test_streaming_weight_minhash();
+        test_prob_minhash();
+        test_simhash();
+        test_hamming_index();
+        test_kmer_natural_vector();
+        test_hyperloglog();
+        test_minhash_containment();
+        test_super_minhash();
+        test_bottom_k_sketch();
+        test_parallel_dna_minhash();
+        test_multi_k_minhash();
+        test_minimizer();
+        test_windowed_minhash();
+        test_hyper_minhash();
+        test_sketch_file();
     }
 }
 namespace std {